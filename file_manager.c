@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <ncurses.h>
 #include <panel.h>
 #include <string.h>
@@ -6,29 +7,220 @@
 #include <time.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <zlib.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
 
 
-#define MAX_FILES 1000
 #define MAX_PATH 1024
+#define FRAME_INTERVAL_MS 16   // Giới hạn tốc độ vẽ lại (~60 khung hình/giây)
+
+// Listing ảo cho thư mục lớn
+#define VIRTUAL_THRESHOLD 4096   // Quá số entry này thì chuyển sang chế độ ảo
+#define ENUM_BATCH 4096          // Số tên luồng nền đọc mỗi lượt
+#define STAT_BATCH 64            // Số entry stat mỗi lượt
+#define STAT_AHEAD_SCREENS 2     // Stat trước bao nhiêu màn hình quanh vùng hiển thị
+#define AVG_DIRENT_SIZE 32       // Ước lượng số byte mỗi entry trong st_size của thư mục
+#define NAME_BLOCK_SIZE (1 << 20)
+#define RELOAD_CHANGED 1         // reload_pending: inotify/snapshot báo thư mục đã đổi
+#define RELOAD_FORCE 2           // reload_pending: thao tác của người dùng, đọc lại cả listing ảo
+
+// Duyệt archive như thư mục ảo
+#define ARCHIVE_CACHE_MAX 8       // Số archive giữ index trong bộ nhớ
+#define ARCHIVE_RELIST_MS 250     // Chu kỳ làm mới listing khi archive còn đang được index
+#define GZ_SPAN (16 << 20)        // Khoảng cách giữa hai checkpoint gzip (byte đã giải nén)
+#define GZ_WINSIZE 32768          // Cửa sổ deflate lưu kèm mỗi checkpoint
+#define GZ_CHUNK 65536
+#define TAR_EXTRA_MAX 65536       // Giới hạn dữ liệu tên dài GNU / header pax
+#define INDEX_MAGIC "FMIDX001"
+#define INDEX_CACHE_MIN (64LL << 20)  // tar/tar.gz nhỏ hơn được index lại nhanh, không lưu xuống đĩa
+#define ENTRY_FILE 0              // Loại entry không phải thư mục (FileItem.kind, ArchiveMember.kind)
+#define ENTRY_SYMLINK 1
+#define ENTRY_HARDLINK 2
+#define ENTRY_SPECIAL 3           // Thiết bị, FIFO...: không giải nén
+
+// Backend I/O cho stat theo lô và chép file
+#define IO_BACKEND_SYNC 0
+#define IO_BACKEND_POOL 1
+#define IO_BACKEND_URING 2
+#define IO_QUEUE_DEPTH 256        // Số request io_uring đang bay tối đa
+#define IO_POOL_THREADS 8
+#define COPY_CHUNK (128 * 1024)
+#define COPY_BATCH 1024           // Số file mỗi lô chép
+
+// Quick view
+#define PREVIEW_CACHE_MAX 64      // Số kết quả preview giữ lại (LRU)
+#define PREVIEW_BYTES 16384       // Số byte tối đa đọc từ đầu file
+#define PREVIEW_BUDGET_MS 200     // Thời gian tối đa cho một request
+#define PREVIEW_SETTLE_MS 40      // Con trỏ phải đứng yên chừng này trước khi bắt đầu đọc
+
+// Phiên làm việc và snapshot listing (FM_SNAPSHOT=1)
+#define SNAPSHOT_MAGIC "FMSNAP01"
+#define SNAPSHOT_DIR 1            // Cờ của SnapshotEntry
+#define SNAPSHOT_STAT 2
+#define SNAPSHOT_NONE 0           // Trạng thái listing lấy từ snapshot
+#define SNAPSHOT_CHECKING 1
+#define SNAPSHOT_FRESH 2
+#define SNAPSHOT_STALE 3
 
 typedef struct {
-    char name[256];
+    char *name;          // Trỏ vào vùng nhớ tên của panel (NameBlock)
     int is_dir;
+    int has_stat;        // 0 = chưa có size/mtime (chế độ ảo, chưa stat)
     off_t size;
     time_t mtime;
+    int kind;            // ENTRY_*; chỉ entry trong archive phân biệt symlink/hardlink
 } FileItem;
 
+// Khối nhớ chứa tên file; không bao giờ di chuyển nên con trỏ name luôn hợp lệ
+typedef struct NameBlock {
+    struct NameBlock *next;
+    size_t used;
+    char data[NAME_BLOCK_SIZE];
+} NameBlock;
+
+// Một file cần chép (dùng chung cho mọi backend I/O)
+typedef struct {
+    char src[MAX_PATH];
+    char dst[MAX_PATH];
+    off_t size;
+    mode_t mode;
+    time_t mtime;
+    int failed;
+    int created;         // dst do lô này tạo ra: chép lại được phép ghi đè
+    int src_fd;          // Trạng thái riêng của đường io_uring
+    int dst_fd;
+    off_t next_offset;
+    int pending;
+} CopyJob;
+
+typedef enum { ARCHIVE_ZIP, ARCHIVE_TAR, ARCHIVE_TGZ } ArchiveType;
+
+typedef struct {
+    char *path;          // Đường dẫn bên trong archive, không có "/" ở đầu và cuối
+    int is_dir;
+    off_t size;
+    time_t mtime;
+    off_t offset;        // tar: vị trí dữ liệu trong luồng đã giải nén; zip: local header
+    off_t comp_size;     // zip: kích thước đã nén
+    int method;          // zip: 0 = stored, 8 = deflate
+    int kind;            // ENTRY_*
+    char *link;          // tar: đích của symlink/hardlink (zip: đích nằm trong dữ liệu)
+} ArchiveMember;
+
+// Checkpoint để giải nén gzip từ giữa luồng mà không phải bắt đầu từ đầu file
+typedef struct {
+    off_t out;           // Vị trí trong luồng đã giải nén
+    off_t in;            // Vị trí trong file nén
+    int bits;            // Số bit của byte trước `in` còn thuộc về block hiện tại
+    unsigned char window[GZ_WINSIZE];
+} GzPoint;
+
+typedef struct {
+    char path[MAX_PATH];
+    ArchiveType type;
+    dev_t dev;           // (dev, ino, mtime, size) là khoá cache
+    ino_t ino;
+    time_t mtime;
+    off_t file_size;
+    int refs;            // Số panel đang mở archive này
+    
+    // Index; được luồng nền ghi dần với tar/tar.gz nên phải giữ lock khi đọc
+    ArchiveMember *members;
+    int member_count;
+    int member_capacity;
+    NameBlock *names;
+    GzPoint *points;
+    int point_count;
+    int point_capacity;
+    int indexing;
+    int index_error;
+    
+    unsigned char *map;  // zip: toàn bộ file được mmap
+    size_t map_size;
+    pthread_t indexer;
+    int indexer_running;
+    volatile int stop;
+    pthread_mutex_t lock;
+} Archive;
+
 typedef struct {
     WINDOW *win;
     PANEL *panel;
     char current_path[MAX_PATH];
-    FileItem files[MAX_FILES];
+    FileItem *files;
     int file_count;
+    int file_capacity;
+    NameBlock *names;
     int selected_idx;
     int start_idx;
     int active;
+    int watch_wd;        // inotify watch của thư mục hiện tại (-1 nếu không có)
+    int reload_pending;  // RELOAD_*: thư mục cần đọc lại ở khung hình tiếp theo
+    
+    // Chế độ ảo: tên được liệt kê trước, size/mtime lấy dần quanh vùng hiển thị.
+    // Mọi truy cập files/file_count phải giữ lock khi worker đang chạy.
+    int virtual_mode;
+    int enumerating;     // Worker vẫn đang đọc tên
+    long est_count;      // Ước lượng tổng số entry cho thanh cuộn
+    char select_pending[256];  // Entry cần chọn khi worker liệt kê tới (sau khi đọc lại)
+    int view_rows;       // Số dòng hiển thị, để worker biết vùng cần ưu tiên
+    DIR *vdir;
+    pthread_t worker;
+    int worker_running;
+    int worker_stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    
+    // Đang duyệt bên trong archive (NULL nếu là thư mục thật)
+    Archive *archive;
+    char archive_prefix[MAX_PATH];  // Thư mục hiện tại trong archive, "" hoặc kết thúc bằng "/"
+    int listed_members;             // Số member đã có khi listing được dựng
+    int archive_indexing;
+    long long listed_at;
+    
+    // Định danh thư mục lúc listing được đọc, để snapshot biết listing còn đúng không
+    dev_t listed_dev;
+    ino_t listed_ino;       // 0 nếu không có (archive, lỗi đọc)
+    struct timespec listed_mtime;
+    
+    // Listing lấy từ snapshot lúc khởi động, đang được kiểm tra lại ở nền
+    int snapshot_state;
+    DIR *snapshot_dir;      // Thư mục đã mở bởi luồng kiểm tra (khi FRESH)
+    pthread_t revalidator;
+    int revalidator_started;
+    int revalidating;
 } FilePanel;
 
+// Trạng thái được lưu lại giữa các lần chạy
+typedef struct {
+    char path[2][MAX_PATH];
+    char selected[2][256];
+    int row[2];               // Vị trí dòng của con trỏ trong panel
+    int active;               // 0 = trái, 1 = phải
+    int quick_view;
+} Session;
+
+// Trạng thái vòng lặp sự kiện
+int wake_fd = -1;       // eventfd để các luồng nền đánh thức vòng lặp chính
+int inotify_fd = -1;    // inotify theo dõi thư mục của hai panel
+volatile sig_atomic_t resize_pending = 0;
+FilePanel *all_panels[2];
+Archive *archive_cache[ARCHIVE_CACHE_MAX];
+int quick_view = 0;     // Panel không hoạt động đang hiển thị quick view
+
 // Khai báo prototype
 void init_colors();
 void init_panel(FilePanel *p, int height, int width, int y, int x, const char *path);
@@ -36,8 +228,62 @@ void read_directory(FilePanel *p);
 void display_panel(FilePanel *p);
 void display_bottom_menu();
 void handle_key(int key, FilePanel *left, FilePanel *right, FilePanel **active);
+void display_header();
+void render(FilePanel *left, FilePanel *right);
+void handle_resize(FilePanel *left, FilePanel *right);
+void watch_directory(FilePanel *p);
+void handle_inotify();
+void reload_directory(FilePanel *p);
+void wake_main_loop();
+long long now_ms();
+void sigwinch_handler(int sig);
+FileItem *append_file(FilePanel *p, const char *name);
+void clear_files(FilePanel *p);
+void stat_entry(int dfd, FileItem *file);
+void ensure_stat(FilePanel *p, int idx);
+void start_worker(FilePanel *p);
+void stop_worker(FilePanel *p);
+void *listing_worker(void *arg);
+char *store_name(NameBlock **blocks, const char *name);
+void sort_files(FilePanel *p);
+void select_file(FilePanel *p, const char *name);
+int archive_type(const char *name);
+Archive *open_archive(const char *path);
+void release_archive(Archive *a);
+void close_archives();
+void *archive_indexer(void *arg);
+void read_archive_dir(FilePanel *p);
+int archive_changed(FilePanel *p);
+void enter_archive(FilePanel *p, const char *name, int is_dir);
+void handle_extract(FilePanel *p, FilePanel *dst);
+int path_is_safe(const char *rel);
+void io_init();
+void io_stat_batch(int dfd, FileItem *files, int count);
+int io_copy_batch(CopyJob *jobs, int count);
+void io_thread_exit();
+int write_all(int fd, const unsigned char *buf, size_t len);
+void handle_copy(FilePanel *p, FilePanel *dst);
+int run_benchmark(int argc, char **argv);
+void display_quick_view(FilePanel *p, FilePanel *src);
+void preview_shutdown();
+int make_dirs(const char *path);
+int state_path(char *buf, size_t size, const char *xdg, const char *fallback, const char *name, int create);
+int snapshot_restore(FilePanel *p);
+int snapshot_check(FilePanel *p);
+void snapshot_discard(FilePanel *p);
+void session_load(Session *s);
+void session_select(FilePanel *p, const Session *s, int side);
+void session_save(FilePanel *left, FilePanel *right, FilePanel *active);
+void snapshot_open();
+void snapshot_save(FilePanel **panels, int count);
+void snapshot_shutdown(FilePanel *p);
+void snapshot_close();
 
-int main() {
+int main(int argc, char **argv) {
+    io_init();
+    if (argc > 2 && strncmp(argv[1], "--bench", 7) == 0)
+        return run_benchmark(argc, argv);
+    
     // Khởi tạo ncurses
     initscr();
     cbreak();
@@ -47,6 +293,17 @@ int main() {
     init_colors();
     curs_set(0);
     
+    // Khởi tạo các nguồn sự kiện (trước khi đọc thư mục để có thể đặt watch)
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    
+    // Thay handler SIGWINCH của ncurses: chỉ đánh dấu và đánh thức poll
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigwinch_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, NULL);
+    
     // Lấy kích thước màn hình
     int max_y, max_x;
     getmaxyx(stdscr, max_y, max_x);
@@ -55,16 +312,166 @@ int main() {
     int panel_height = max_y - 4; // Để dành 1 dòng cho header và 3 dòng cho footer
     int panel_width = max_x / 2;
     
+    // Khôi phục phiên trước: listing có trong snapshot được hiển thị ngay
+    Session session;
+    session_load(&session);
+    snapshot_open();
+    
     // Tạo hai panel
     FilePanel left_panel, right_panel;
-    init_panel(&left_panel, panel_height, panel_width, 1, 0, ".");
-    init_panel(&right_panel, panel_height, panel_width, 1, panel_width, ".");
+    all_panels[0] = &left_panel;
+    all_panels[1] = &right_panel;
+    init_panel(&left_panel, panel_height, panel_width, 1, 0,
+               session.path[0][0] ? session.path[0] : ".");
+    init_panel(&right_panel, panel_height, max_x - panel_width, 1, panel_width,
+               session.path[1][0] ? session.path[1] : ".");
+    session_select(&left_panel, &session, 0);
+    session_select(&right_panel, &session, 1);
+    
+    FilePanel *active_panel = session.active ? &right_panel : &left_panel;
+    left_panel.active = active_panel == &left_panel;
+    right_panel.active = active_panel == &right_panel;
+    quick_view = session.quick_view;
+    
+    // Vẽ header menu và hiển thị panel lần đầu
+    display_header();
+    render(&left_panel, &right_panel);
+    
+    // Các fd mà vòng lặp chính chờ
+    struct pollfd fds[3];
+    int nfds = 0;
+    fds[nfds].fd = STDIN_FILENO;
+    fds[nfds++].events = POLLIN;
+    if (wake_fd >= 0) {
+        fds[nfds].fd = wake_fd;
+        fds[nfds++].events = POLLIN;
+    }
+    if (inotify_fd >= 0) {
+        fds[nfds].fd = inotify_fd;
+        fds[nfds++].events = POLLIN;
+    }
+    
+    // getch() chỉ dùng để rút phím đang chờ, không bao giờ chặn
+    nodelay(stdscr, TRUE);
+    
+    // Vòng lặp chính: chờ sự kiện, xử lý hết phím đang chờ rồi mới vẽ,
+    // và vẽ tối đa một lần mỗi FRAME_INTERVAL_MS
+    int running = 1;
+    int dirty = 0;
+    long long last_frame = now_ms();
+    while (running) {
+        int timeout_ms = -1;
+        if (dirty || left_panel.reload_pending || right_panel.reload_pending) {
+            long long wait = last_frame + FRAME_INTERVAL_MS - now_ms();
+            timeout_ms = wait > 0 ? (int)wait : 0;
+        }
+        
+        // Archive đang được index: thức dậy theo chu kỳ để làm mới listing
+        // (luồng index chỉ đánh thức sau mỗi 1024 member và khi xong)
+        if (timeout_ms < 0 && (left_panel.archive_indexing || right_panel.archive_indexing))
+            timeout_ms = ARCHIVE_RELIST_MS;
+        
+        if (poll(fds, nfds, timeout_ms) < 0 && errno != EINTR)
+            break;
+        
+        // Gom toàn bộ phím đang chờ trước khi vẽ
+        int ch;
+        while ((ch = getch()) != ERR) {
+            if (ch == 'q' || ch == KEY_F(10) || ch == KEY_F(9)) {
+                running = 0;
+                break;
+            }
+            if (ch == KEY_RESIZE)
+                resize_pending = 1;
+            else
+                handle_key(ch, &left_panel, &right_panel, &active_panel);
+            dirty = 1;
+        }
+        if (!running)
+            break;
+        
+        if (wake_fd >= 0) {
+            uint64_t count;
+            while (read(wake_fd, &count, sizeof(count)) > 0)
+                dirty = 1;
+        }
+        
+        if (inotify_fd >= 0)
+            handle_inotify();
+        
+        // Đổi kích thước chỉ sắp xếp lại cửa sổ, không đọc lại thư mục
+        if (resize_pending) {
+            resize_pending = 0;
+            handle_resize(&left_panel, &right_panel);
+            dirty = 1;
+        }
+        
+        if (now_ms() - last_frame < FRAME_INTERVAL_MS)
+            continue;
+        
+        // Archive còn đang được index: làm mới listing theo chu kỳ
+        if (archive_changed(&left_panel))
+            left_panel.reload_pending |= RELOAD_CHANGED;
+        if (archive_changed(&right_panel))
+            right_panel.reload_pending |= RELOAD_CHANGED;
+        
+        // Kết quả kiểm tra lại listing lấy từ snapshot
+        if (snapshot_check(&left_panel) | snapshot_check(&right_panel))
+            dirty = 1;
+        
+        if (left_panel.reload_pending) {
+            reload_directory(&left_panel);
+            dirty = 1;
+        }
+        if (right_panel.reload_pending) {
+            reload_directory(&right_panel);
+            dirty = 1;
+        }
+        
+        if (dirty) {
+            render(&left_panel, &right_panel);
+            last_frame = now_ms();
+            dirty = 0;
+        }
+    }
     
-    left_panel.active = 1;
-    right_panel.active = 0;
-    FilePanel *active_panel = &left_panel;
+    stop_worker(&left_panel);
+    stop_worker(&right_panel);
+    session_save(&left_panel, &right_panel, active_panel);
+    snapshot_save(all_panels, 2);
+    snapshot_shutdown(&left_panel);
+    snapshot_shutdown(&right_panel);
+    snapshot_close();
+    preview_shutdown();
+    close_archives();
+    endwin();
+    return 0;
+}
+
+void sigwinch_handler(int sig) {
+    (void)sig;
+    resize_pending = 1;
+    wake_main_loop();
+}
+
+// Đánh thức vòng lặp chính (an toàn khi gọi từ signal handler và luồng khác)
+void wake_main_loop() {
+    uint64_t one = 1;
+    if (wake_fd >= 0) {
+        ssize_t r = write(wake_fd, &one, sizeof(one));
+        (void)r;
+    }
+}
+
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void display_header() {
+    int max_x = getmaxx(stdscr);
     
-    // Vẽ header menu
     attron(COLOR_PAIR(3));
     mvhline(0, 0, ' ', max_x);
     mvprintw(0, 2, "Left");
@@ -73,28 +480,122 @@ int main() {
     mvprintw(0, 50, "Options");
     mvprintw(0, 65, "Right");
     attroff(COLOR_PAIR(3));
-    
-    // Hiển thị panel và menu
-    update_panels();
-    display_panel(&left_panel);
-    display_panel(&right_panel);
+}
+
+// Vẽ một khung hình: dựng lại nội dung rồi đẩy ra terminal bằng một lần doupdate()
+// (stdscr phải được đẩy trước để không đè lên các panel)
+void render(FilePanel *left, FilePanel *right) {
     display_bottom_menu();
+    display_panel(left);
+    display_panel(right);
+    update_panels();
     doupdate();
+}
+
+void handle_resize(FilePanel *left, FilePanel *right) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0)
+        resize_term(ws.ws_row, ws.ws_col);
     
-    // Vòng lặp chính
-    int ch;
-    while ((ch = getch()) != 'q' && ch != KEY_F(10) && ch != KEY_F(9)) {
-        handle_key(ch, &left_panel, &right_panel, &active_panel);
-        
-        display_panel(&left_panel);
-        display_panel(&right_panel);
-        display_bottom_menu();
-        
-        doupdate();
+    int max_y, max_x;
+    getmaxyx(stdscr, max_y, max_x);
+    
+    int panel_height = max_y - 4;
+    int panel_width = max_x / 2;
+    if (panel_height < 4)
+        panel_height = 4;
+    
+    wresize(left->win, panel_height, panel_width);
+    move_panel(left->panel, 1, 0);
+    wresize(right->win, panel_height, max_x - panel_width);
+    move_panel(right->panel, 1, panel_width);
+    
+    werase(stdscr);
+    display_header();
+}
+
+// Đặt inotify watch cho thư mục hiện tại của panel, bỏ watch cũ nếu panel kia không dùng
+void watch_directory(FilePanel *p) {
+    if (inotify_fd < 0)
+        return;
+    
+    // Bên trong archive không có thư mục thật để theo dõi
+    int old_wd = p->watch_wd;
+    if (p->archive != NULL)
+        p->watch_wd = -1;
+    else
+        p->watch_wd = inotify_add_watch(inotify_fd, p->current_path,
+                                        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                        IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+    
+    if (old_wd < 0 || old_wd == p->watch_wd)
+        return;
+    for (int i = 0; i < 2; i++) {
+        if (all_panels[i] != p && all_panels[i]->watch_wd == old_wd)
+            return;
     }
+    inotify_rm_watch(inotify_fd, old_wd);
+}
+
+// Đọc hết sự kiện inotify, chỉ đánh dấu panel cần đọc lại (việc đọc được gom theo khung hình)
+void handle_inotify() {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
     
-    endwin();
-    return 0;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        char *ptr = buf;
+        while (ptr < buf + len) {
+            struct inotify_event *ev = (struct inotify_event *)ptr;
+            for (int i = 0; i < 2; i++) {
+                if (all_panels[i]->watch_wd == ev->wd)
+                    all_panels[i]->reload_pending |= RELOAD_CHANGED;
+            }
+            ptr += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+// Đọc lại thư mục sau khi có thay đổi, giữ con trỏ ở file đang chọn nếu còn tồn tại
+void reload_directory(FilePanel *p) {
+    char selected[256] = "";
+    int old_idx = p->selected_idx;
+    int old_start = p->start_idx;
+    int reason = p->reload_pending;
+    
+    p->reload_pending = 0;
+    
+    // Đọc lại cả thư mục khổng lồ mỗi lần inotify báo thay đổi quá tốn kém: listing ảo
+    // chỉ được làm mới khi người dùng vào lại thư mục hoặc sau thao tác chép/giải nén vào đó
+    if (p->virtual_mode && !(reason & RELOAD_FORCE))
+        return;
+    
+    // Worker của listing ảo có thể cấp phát lại mảng files: chép tên dưới khoá
+    pthread_mutex_lock(&p->lock);
+    if (p->selected_idx < p->file_count)
+        snprintf(selected, sizeof(selected), "%s", p->files[p->selected_idx].name);
+    pthread_mutex_unlock(&p->lock);
+    
+    read_directory(p);
+    
+    pthread_mutex_lock(&p->lock);
+    p->selected_idx = old_idx < p->file_count ? old_idx : p->file_count - 1;
+    p->start_idx = old_start;
+    select_file(p, selected);
+    
+    // Listing ảo mới chỉ có phần đầu: worker chọn entry cũ khi liệt kê tới
+    if (p->enumerating && strcmp(p->files[p->selected_idx].name, selected) != 0)
+        snprintf(p->select_pending, sizeof(p->select_pending), "%s", selected);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Đặt con trỏ vào entry có tên cho trước (nếu có)
+void select_file(FilePanel *p, const char *name) {
+    for (int i = 0; i < p->file_count; i++) {
+        if (strcmp(p->files[i].name, name) == 0) {
+            p->selected_idx = i;
+            break;
+        }
+    }
 }
 
 void init_colors() {
@@ -116,523 +617,3857 @@ void init_panel(FilePanel *p, int height, int width, int y, int x, const char *p
     box(p->win, 0, 0);
     
     strcpy(p->current_path, path);
+    p->files = NULL;
+    p->file_count = 0;
+    p->file_capacity = 0;
+    p->names = NULL;
     p->selected_idx = 0;
     p->start_idx = 0;
+    p->active = 0;
+    p->watch_wd = -1;
+    p->reload_pending = 0;
+    p->virtual_mode = 0;
+    p->enumerating = 0;
+    p->est_count = 0;
+    p->select_pending[0] = '\0';
+    p->view_rows = height - 3;
+    p->vdir = NULL;
+    p->worker_running = 0;
+    p->worker_stop = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    p->archive = NULL;
+    p->archive_prefix[0] = '\0';
+    p->listed_members = 0;
+    p->archive_indexing = 0;
+    p->listed_at = 0;
+    p->listed_dev = 0;
+    p->listed_ino = 0;
+    p->snapshot_state = SNAPSHOT_NONE;
+    p->snapshot_dir = NULL;
+    p->revalidator_started = 0;
+    p->revalidating = 0;
+    
+    // Có listing trong snapshot: hiển thị ngay, không đọc thư mục
+    if (!snapshot_restore(p))
+        read_directory(p);
+}
+
+// Chép tên vào danh sách NameBlock, trả về con trỏ ổn định tới bản sao
+char *store_name(NameBlock **blocks, const char *name) {
+    size_t len = strlen(name) + 1;
+    
+    if (*blocks == NULL || (*blocks)->used + len > NAME_BLOCK_SIZE) {
+        NameBlock *block = malloc(sizeof(NameBlock));
+        if (block == NULL)
+            return NULL;
+        block->next = *blocks;
+        block->used = 0;
+        *blocks = block;
+    }
+    
+    char *copy = (*blocks)->data + (*blocks)->used;
+    memcpy(copy, name, len);
+    (*blocks)->used += len;
+    return copy;
+}
+
+// Thêm một entry vào cuối danh sách (tên được chép vào NameBlock của panel)
+FileItem *append_file(FilePanel *p, const char *name) {
+    if (p->file_count == p->file_capacity) {
+        int new_capacity = p->file_capacity ? p->file_capacity * 2 : 256;
+        FileItem *files = realloc(p->files, new_capacity * sizeof(FileItem));
+        if (files == NULL)
+            return NULL;
+        p->files = files;
+        p->file_capacity = new_capacity;
+    }
+    
+    char *copy = store_name(&p->names, name);
+    if (copy == NULL)
+        return NULL;
+    
+    FileItem *file = &p->files[p->file_count++];
+    file->name = copy;
+    file->is_dir = 0;
+    file->has_stat = 0;
+    file->size = 0;
+    file->mtime = 0;
+    file->kind = ENTRY_FILE;
+    return file;
+}
+
+void clear_files(FilePanel *p) {
+    while (p->names != NULL) {
+        NameBlock *next = p->names->next;
+        free(p->names);
+        p->names = next;
+    }
     p->file_count = 0;
+}
+
+int compare_files(const void *a, const void *b) {
+    const FileItem *fa = a, *fb = b;
+    if (fa->is_dir != fb->is_dir)
+        return fb->is_dir - fa->is_dir;
+    return strcmp(fa->name, fb->name);
+}
+
+// Sắp xếp thư mục lên trước rồi theo tên, ".." luôn đứng đầu
+void sort_files(FilePanel *p) {
+    if (p->file_count > 2)
+        qsort(p->files + 1, p->file_count - 1, sizeof(FileItem), compare_files);
+}
+
+void stat_entry(int dfd, FileItem *file) {
+    struct stat st;
+    if (fstatat(dfd, file->name, &st, 0) == 0) {
+        file->is_dir = S_ISDIR(st.st_mode);
+        file->size = st.st_size;
+        file->mtime = st.st_mtime;
+    }
+    file->has_stat = 1;
+}
+
+// Bảo đảm entry đã có metadata trước khi thao tác (gọi từ luồng chính)
+void ensure_stat(FilePanel *p, int idx) {
+    if (idx < 0 || idx >= p->file_count || p->files[idx].has_stat)
+        return;
     
-    read_directory(p);
+    // Trong archive, entry chưa có metadata là thư mục ngầm định (dựng từ member sâu hơn),
+    // không có gì để stat trên hệ thống file thật
+    if (p->archive != NULL)
+        return;
+    
+    char name[256];
+    snprintf(name, sizeof(name), "%s", p->files[idx].name);
+    
+    // Listing từ snapshot chưa có thư mục mở: stat theo đường dẫn đầy đủ
+    char path[MAX_PATH];
+    if (p->vdir == NULL)
+        snprintf(path, sizeof(path), "%s/%s", p->current_path, name);
+    // stat lỗi (symlink hỏng, EACCES) thì giữ is_dir từ d_type, size/mtime bằng 0
+    FileItem tmp = {p->vdir ? name : path, p->files[idx].is_dir, 0, 0, 0, ENTRY_FILE};
+    stat_entry(p->vdir ? dirfd(p->vdir) : AT_FDCWD, &tmp);
+    p->files[idx].is_dir = tmp.is_dir;
+    p->files[idx].size = tmp.size;
+    p->files[idx].mtime = tmp.mtime;
+    p->files[idx].has_stat = 1;
 }
 
 void read_directory(FilePanel *p) {
     DIR *dir;
-    struct dirent *entry;
+    struct dirent *entry = NULL;
     struct stat st;
-    char full_path[MAX_PATH];
+    FileItem *file;
     
-    p->file_count = 0;
+    // Dừng worker của listing cũ trước khi giải phóng dữ liệu
+    stop_worker(p);
+    snapshot_discard(p);
+    clear_files(p);
+    p->virtual_mode = 0;
+    p->enumerating = 0;
+    p->est_count = 0;
+    p->select_pending[0] = '\0';
+    p->listed_ino = 0;
+    watch_directory(p);
     
     // Thêm ".." để quay lại thư mục cha
-    strcpy(p->files[p->file_count].name, "..");
-    p->files[p->file_count].is_dir = 1;
-    p->files[p->file_count].size = 4096;
-    p->files[p->file_count].mtime = time(NULL);
-    p->file_count++;
+    file = append_file(p, "..");
+    file->is_dir = 1;
+    file->has_stat = 1;
+    file->size = 4096;
+    file->mtime = time(NULL);
+    
+    // Archive dùng chung listing, sắp xếp và hiển thị với thư mục thật
+    if (p->archive != NULL) {
+        read_archive_dir(p);
+        return;
+    }
     
     if ((dir = opendir(p->current_path)) == NULL) {
         mvwprintw(p->win, 1, 1, "Không thể mở thư mục!");
         return;
     }
     
-    while ((entry = readdir(dir)) != NULL && p->file_count < MAX_FILES) {
+    // Lấy mtime trước khi đọc: thay đổi xảy ra trong lúc đọc sẽ làm snapshot bị coi là cũ
+    if (fstat(dirfd(dir), &st) == 0) {
+        p->listed_dev = st.st_dev;
+        p->listed_ino = st.st_ino;
+        p->listed_mtime = st.st_mtim;
+    }
+    
+    // Bước 1: chỉ liệt kê tên, d_type cho biết thư mục mà không cần stat
+    while ((entry = readdir(dir)) != NULL) {
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
             continue;
-            
-        strcpy(p->files[p->file_count].name, entry->d_name);
         
-        snprintf(full_path, MAX_PATH, "%s/%s", p->current_path, entry->d_name);
-        if (stat(full_path, &st) == 0) {
-            p->files[p->file_count].is_dir = S_ISDIR(st.st_mode);
-            p->files[p->file_count].size = st.st_size;
-            p->files[p->file_count].mtime = st.st_mtime;
-        }
+        if ((file = append_file(p, entry->d_name)) == NULL)
+            break;
+        file->is_dir = entry->d_type == DT_DIR;
         
-        p->file_count++;
+        if (p->file_count > VIRTUAL_THRESHOLD)
+            break;
+    }
+    
+    // Thư mục lớn: hiển thị ngay, phần còn lại do worker liệt kê và stat dần
+    if (entry != NULL) {
+        p->virtual_mode = 1;
+        p->enumerating = 1;
+        p->vdir = dir;
+        p->est_count = p->file_count;
+        if (p->listed_ino != 0 && st.st_size / AVG_DIRENT_SIZE > p->est_count)
+            p->est_count = st.st_size / AVG_DIRENT_SIZE;
+        start_worker(p);
+        return;
     }
     
+    // Thư mục nhỏ: stat toàn bộ ngay như trước, theo lô qua backend I/O
+    io_stat_batch(dirfd(dir), p->files + 1, p->file_count - 1);
+    
     closedir(dir);
+    sort_files(p);
 }
 
-void display_panel(FilePanel *p) {
-    int i;
-    int height, width;
-    struct tm *timeinfo;
-    char date_str[20];
-    
-    werase(p->win);
-    wbkgd(p->win, COLOR_PAIR(p->active ? 2 : 1));
-    box(p->win, 0, 0);
-    
-    getmaxyx(p->win, height, width);
-    
-    // Header cho danh sách file
-    mvwprintw(p->win, 1, 2, "Name");
-    mvwprintw(p->win, 1, width - 32, "Size");
-    mvwprintw(p->win, 1, width - 16, "Modify time");
-    
-    // Hiển thị file
-    int display_count = height - 3; // Để trừ header và border
-    
-    // Đảm bảo start_idx không vượt quá giới hạn
-    if (p->file_count > display_count) {
-        if (p->start_idx > p->file_count - display_count)
-            p->start_idx = p->file_count - display_count;
-    } else {
-        p->start_idx = 0;
+void start_worker(FilePanel *p) {
+    p->worker_stop = 0;
+    if (pthread_create(&p->worker, NULL, listing_worker, p) == 0)
+        p->worker_running = 1;
+}
+
+void stop_worker(FilePanel *p) {
+    if (p->worker_running) {
+        pthread_mutex_lock(&p->lock);
+        p->worker_stop = 1;
+        pthread_cond_signal(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+        
+        pthread_join(p->worker, NULL);
+        p->worker_running = 0;
     }
     
-    // Đảm bảo selected_idx luôn nằm trong vùng hiển thị
-    if (p->selected_idx < p->start_idx)
-        p->start_idx = p->selected_idx;
-    if (p->selected_idx >= p->start_idx + display_count)
-        p->start_idx = p->selected_idx - display_count + 1;
+    if (p->vdir != NULL) {
+        closedir(p->vdir);
+        p->vdir = NULL;
+    }
+}
+
+// Worker của listing ảo: ưu tiên stat các dòng trong và gần vùng hiển thị,
+// khi rảnh thì đọc tiếp tên, hết việc thì ngủ chờ vùng hiển thị thay đổi
+void *listing_worker(void *arg) {
+    FilePanel *p = arg;
+    int dfd = dirfd(p->vdir);
+    int batch[STAT_BATCH];
+    FileItem results[STAT_BATCH];
+    char names[STAT_BATCH][256];
+    char *enum_names = malloc(ENUM_BATCH * 256);
+    unsigned char *enum_types = malloc(ENUM_BATCH);
     
-    for (i = 0; i < display_count && i + p->start_idx < p->file_count; i++) {
-        FileItem *file = &p->files[i + p->start_idx];
-        timeinfo = localtime(&file->mtime);
-        strftime(date_str, 20, "%b %d %H:%M", timeinfo);
+    pthread_mutex_lock(&p->lock);
+    while (!p->worker_stop) {
+        // Thứ tự ưu tiên: vùng hiển thị, phía dưới, rồi phía trên
+        int n = 0;
+        int rows = p->view_rows > 0 ? p->view_rows : 1;
+        int ranges[3][2] = {
+            {p->start_idx, p->start_idx + rows},
+            {p->start_idx + rows, p->start_idx + rows * (1 + STAT_AHEAD_SCREENS)},
+            {p->start_idx - rows * STAT_AHEAD_SCREENS, p->start_idx}
+        };
+        for (int r = 0; r < 3 && n < STAT_BATCH; r++) {
+            int lo = ranges[r][0] < 0 ? 0 : ranges[r][0];
+            int hi = ranges[r][1] > p->file_count ? p->file_count : ranges[r][1];
+            for (int i = lo; i < hi && n < STAT_BATCH; i++) {
+                if (!p->files[i].has_stat) {
+                    batch[n] = i;
+                    snprintf(names[n], sizeof(names[n]), "%s", p->files[i].name);
+                    results[n].is_dir = p->files[i].is_dir;
+                    n++;
+                }
+            }
+        }
         
-        // Highlight file được chọn
-        if (i + p->start_idx == p->selected_idx)
-            wattron(p->win, A_REVERSE);
-            
-        // Với thư mục, sử dụng màu đặc biệt
-        if (file->is_dir)
-            wattron(p->win, COLOR_PAIR(5));
+        if (n > 0) {
+            pthread_mutex_unlock(&p->lock);
+            // stat lỗi thì giữ nguyên giá trị khởi tạo: is_dir từ d_type, size/mtime bằng 0
+            for (int i = 0; i < n; i++) {
+                results[i].name = names[i];
+                results[i].has_stat = 0;
+                results[i].size = 0;
+                results[i].mtime = 0;
+            }
+            io_stat_batch(dfd, results, n);
+            pthread_mutex_lock(&p->lock);
             
-        mvwprintw(p->win, i + 2, 2, "%-15s", file->name);
+            // Listing không thể bị thay trong lúc worker chạy nên chỉ số vẫn hợp lệ
+            for (int i = 0; i < n; i++) {
+                FileItem *file = &p->files[batch[i]];
+                file->is_dir = results[i].is_dir;
+                file->size = results[i].size;
+                file->mtime = results[i].mtime;
+                file->has_stat = 1;
+            }
+            wake_main_loop();
+            continue;
+        }
         
-        if (strcmp(file->name, "..") == 0)
-            mvwprintw(p->win, i + 2, width - 32, "UP--DIR");
-        else
-            mvwprintw(p->win, i + 2, width - 32, "%4ldK", file->size / 1024);
+        if (p->enumerating && enum_names != NULL && enum_types != NULL) {
+            pthread_mutex_unlock(&p->lock);
+            int count = 0;
+            struct dirent *entry = NULL;
+            while (count < ENUM_BATCH && (entry = readdir(p->vdir)) != NULL) {
+                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                    continue;
+                snprintf(enum_names + count * 256, 256, "%s", entry->d_name);
+                enum_types[count] = entry->d_type;
+                count++;
+            }
+            pthread_mutex_lock(&p->lock);
             
-        mvwprintw(p->win, i + 2, width - 16, "%s", date_str);
-        
-        if (file->is_dir)
-            wattroff(p->win, COLOR_PAIR(5));
+            for (int i = 0; i < count; i++) {
+                FileItem *file = append_file(p, enum_names + i * 256);
+                if (file == NULL) {
+                    entry = NULL;
+                    break;
+                }
+                file->is_dir = enum_types[i] == DT_DIR;
+                if (p->select_pending[0] != '\0' && strcmp(file->name, p->select_pending) == 0) {
+                    p->selected_idx = p->file_count - 1;
+                    p->select_pending[0] = '\0';
+                }
+            }
             
-        if (i + p->start_idx == p->selected_idx)
-            wattroff(p->win, A_REVERSE);
-    }
-    
-    // Vẽ thanh cuộn nếu cần
-    if (p->file_count > display_count) {
-        int scrollbar_height = height - 2;
-        
-        // Tính toán vị trí thanh cuộn
-        double ratio = (double)p->start_idx / (p->file_count - display_count);
-        int scrollbar_pos = 1 + (int)(ratio * (scrollbar_height - 1));
-        
-        // Tính toán kích thước thanh cuộn
-        int scrollbar_size = (display_count * scrollbar_height) / p->file_count;
-        if (scrollbar_size < 1) scrollbar_size = 1;
-        if (scrollbar_pos + scrollbar_size > scrollbar_height)
-            scrollbar_size = scrollbar_height - scrollbar_pos + 1;
-        
-        // Vẽ đường dẫn thanh cuộn
-        for (i = 1; i <= scrollbar_height; i++) {
-            mvwaddch(p->win, i, width - 1, ACS_VLINE);
+            // Tinh chỉnh ước lượng: khi đã vượt thì nới thêm, khi đọc xong thì lấy số thật
+            if (entry == NULL) {
+                p->enumerating = 0;
+                p->est_count = p->file_count;
+            } else if (p->file_count >= p->est_count) {
+                p->est_count = p->file_count + p->file_count / 8;
+            }
+            wake_main_loop();
+            continue;
         }
         
-        // Vẽ thanh cuộn
-        wattron(p->win, A_REVERSE);
-        for (i = 0; i < scrollbar_size && scrollbar_pos + i <= scrollbar_height; i++) {
-            mvwaddch(p->win, scrollbar_pos + i, width - 1, ' ');
-        }
-        wattroff(p->win, A_REVERSE);
+        pthread_cond_wait(&p->cond, &p->lock);
     }
+    pthread_mutex_unlock(&p->lock);
     
-    // Hiển thị đường dẫn hiện tại ở dưới panel
-    mvwprintw(p->win, height - 1, 2, "%s", p->current_path);
+    free(enum_names);
+    free(enum_types);
+    io_thread_exit();
+    return NULL;
+}
+
+// ---- Backend I/O: io_uring khi kernel hỗ trợ, ngược lại pool luồng ----
+
+// Vòng io_uring tối giản dùng syscall trực tiếp
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_local_tail;
+    unsigned to_submit;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+} IoRing;
+
+// Pool luồng: chạy fn(arg, i) với i = 0..count-1 trên nhiều luồng
+typedef struct {
+    pthread_mutex_t caller_lock;   // Mỗi lúc chỉ một lô việc
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    pthread_t threads[IO_POOL_THREADS];
+    int started;
+    void (*fn)(void *arg, int idx);
+    void *arg;
+    int count;
+    int next;
+    int busy;
+    unsigned generation;
+} IoPool;
+
+int io_backend = IO_BACKEND_SYNC;
+IoPool io_pool = {.caller_lock = PTHREAD_MUTEX_INITIALIZER, .lock = PTHREAD_MUTEX_INITIALIZER,
+                  .work_cond = PTHREAD_COND_INITIALIZER, .done_cond = PTHREAD_COND_INITIALIZER};
+__thread IoRing *thread_ring;
+__thread int thread_ring_failed;
+
+int io_ring_init(IoRing *r, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(r, 0, sizeof(*r));
+    
+    r->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (r->fd < 0)
+        return -1;
+    
+    r->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_size > r->sq_ring_size)
+            r->sq_ring_size = r->cq_ring_size;
+        r->cq_ring_size = r->sq_ring_size;
+    }
+    
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        close(r->fd);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        r->cq_ring = r->sq_ring;
+    else
+        r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          r->fd, IORING_OFF_CQ_RING);
+    r->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->cq_ring == MAP_FAILED || r->sqes == MAP_FAILED) {
+        if (r->cq_ring != MAP_FAILED && r->cq_ring != r->sq_ring)
+            munmap(r->cq_ring, r->cq_ring_size);
+        munmap(r->sq_ring, r->sq_ring_size);
+        close(r->fd);
+        return -1;
+    }
     
-    wrefresh(p->win);
+    char *sq = r->sq_ring, *cq = r->cq_ring;
+    r->sq_head = (unsigned *)(sq + params.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + params.sq_off.array);
+    r->cq_head = (unsigned *)(cq + params.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    r->entries = params.sq_entries;
+    r->sq_local_tail = *r->sq_tail;
+    return 0;
 }
 
+void io_ring_free(IoRing *r) {
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+}
 
+// Lấy SQE trống kế tiếp; người gọi tự giới hạn số request đang chạy <= entries
+struct io_uring_sqe *io_ring_sqe(IoRing *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sq_local_tail - head >= r->entries)
+        return NULL;
+    
+    unsigned idx = r->sq_local_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sq_local_tail++;
+    r->to_submit++;
+    return sqe;
+}
 
-void display_bottom_menu() {
-    int max_y, max_x;
-    getmaxyx(stdscr, max_y, max_x);
+// Nộp các SQE mới và chờ ít nhất wait_nr CQE
+int io_ring_submit(IoRing *r, unsigned wait_nr) {
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
     
-    // Vẽ thanh trạng thái và menu
-    attron(COLOR_PAIR(4));
-    mvhline(max_y - 2, 0, ' ', max_x);
-    mvhline(max_y - 1, 0, ' ', max_x);
+    int ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, r->fd, r->to_submit, wait_nr,
+                      wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret >= 0)
+        r->to_submit -= ret < (int)r->to_submit ? ret : (int)r->to_submit;
+    return ret < 0 ? -1 : 0;
+}
+
+struct io_uring_cqe *io_ring_cqe(IoRing *r) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &r->cqes[head & *r->cq_mask];
+}
+
+void io_ring_cqe_seen(IoRing *r) {
+    __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// Mỗi luồng có vòng riêng, tạo khi cần; NULL nếu phải dùng đường pool luồng
+IoRing *io_thread_ring() {
+    if (io_backend != IO_BACKEND_URING || thread_ring_failed)
+        return NULL;
+    if (thread_ring == NULL) {
+        IoRing *r = malloc(sizeof(IoRing));
+        if (r == NULL || io_ring_init(r, IO_QUEUE_DEPTH) != 0) {
+            free(r);
+            thread_ring_failed = 1;
+            return NULL;
+        }
+        thread_ring = r;
+    }
+    return thread_ring;
+}
+
+void io_thread_exit() {
+    if (thread_ring != NULL) {
+        io_ring_free(thread_ring);
+        free(thread_ring);
+        thread_ring = NULL;
+    }
+}
+
+void *io_pool_thread(void *arg) {
+    (void)arg;
+    unsigned seen = 0;
     
-    mvprintw(max_y - 1, 1, "F1 Help");
-    mvprintw(max_y - 1, 10, "F2 Menu");
-    mvprintw(max_y - 1, 19, "F3 View");
-    mvprintw(max_y - 1, 28, "F4 Edit");
-    mvprintw(max_y - 1, 37, "F5 Copy");
-    mvprintw(max_y - 1, 46, "F6 Move");
-    mvprintw(max_y - 1, 55, "F7 Mkdir");
-    mvprintw(max_y - 1, 65, "F8 Delete");
-    mvprintw(max_y - 1, 76, "F9 Quit");
+    pthread_mutex_lock(&io_pool.lock);
+    for (;;) {
+        while (io_pool.generation == seen)
+            pthread_cond_wait(&io_pool.work_cond, &io_pool.lock);
+        seen = io_pool.generation;
+        
+        io_pool.busy++;
+        while (io_pool.next < io_pool.count) {
+            int idx = io_pool.next++;
+            pthread_mutex_unlock(&io_pool.lock);
+            io_pool.fn(io_pool.arg, idx);
+            pthread_mutex_lock(&io_pool.lock);
+        }
+        if (--io_pool.busy == 0)
+            pthread_cond_signal(&io_pool.done_cond);
+    }
+    return NULL;
+}
+
+// Chạy fn trên pool luồng (luồng gọi cũng tham gia), trả về khi mọi việc xong
+void io_pool_run(void (*fn)(void *arg, int idx), void *arg, int count) {
+    pthread_mutex_lock(&io_pool.caller_lock);
+    pthread_mutex_lock(&io_pool.lock);
     
-    attroff(COLOR_PAIR(4));
-    refresh();
+    while (io_pool.started < IO_POOL_THREADS &&
+           pthread_create(&io_pool.threads[io_pool.started], NULL, io_pool_thread, NULL) == 0)
+        pthread_detach(io_pool.threads[io_pool.started++]);
+    
+    io_pool.fn = fn;
+    io_pool.arg = arg;
+    io_pool.count = count;
+    io_pool.next = 0;
+    io_pool.generation++;
+    pthread_cond_broadcast(&io_pool.work_cond);
+    
+    io_pool.busy++;
+    while (io_pool.next < io_pool.count) {
+        int idx = io_pool.next++;
+        pthread_mutex_unlock(&io_pool.lock);
+        fn(arg, idx);
+        pthread_mutex_lock(&io_pool.lock);
+    }
+    io_pool.busy--;
+    while (io_pool.busy > 0)
+        pthread_cond_wait(&io_pool.done_cond, &io_pool.lock);
+    
+    pthread_mutex_unlock(&io_pool.lock);
+    pthread_mutex_unlock(&io_pool.caller_lock);
 }
-// Hàm hiển thị hộp thoại tạo thư mục
-WINDOW *create_dialog_window(int height, int width, int y, int x, const char *title) {
-    WINDOW *win = newwin(height, width, y, x);
-    wbkgd(win, COLOR_PAIR(3));
-    box(win, 0, 0);
-    mvwprintw(win, 0, (width - strlen(title)) / 2, "%s", title);
-    wrefresh(win);
-    return win;
+
+// Chọn backend: FM_IO_BACKEND=uring|pool|sync, mặc định io_uring nếu kernel cho phép
+void io_init() {
+    const char *env = getenv("FM_IO_BACKEND");
+    IoRing probe;
+    
+    if (env != NULL && strcmp(env, "sync") == 0) {
+        io_backend = IO_BACKEND_SYNC;
+    } else if (env != NULL && strcmp(env, "pool") == 0) {
+        io_backend = IO_BACKEND_POOL;
+    } else if (io_ring_init(&probe, 4) == 0) {
+        io_ring_free(&probe);
+        io_backend = IO_BACKEND_URING;
+    } else {
+        io_backend = IO_BACKEND_POOL;
+    }
 }
 
-void handle_mkdir(FilePanel *p) {
-    int max_y, max_x;
-    getmaxyx(stdscr, max_y, max_x);
+const char *io_backend_name(int backend) {
+    return backend == IO_BACKEND_URING ? "io_uring" : backend == IO_BACKEND_POOL ? "pool" : "sync";
+}
+
+typedef struct {
+    int dfd;
+    FileItem *files;
+} StatTask;
+
+void stat_task(void *arg, int idx) {
+    StatTask *task = arg;
+    if (!task->files[idx].has_stat)
+        stat_entry(task->dfd, &task->files[idx]);
+}
+
+// statx theo lô qua io_uring; trả về -1 nếu kernel không hỗ trợ để người gọi dùng đường khác
+int uring_stat_batch(IoRing *r, int dfd, FileItem *files, int count) {
+    int depth = r->entries;
+    struct statx *bufs = malloc(depth * sizeof(struct statx));
+    int *slot_file = malloc(depth * sizeof(int));
+    int *free_slots = malloc(depth * sizeof(int));
+    int free_count = depth, inflight = 0, next = 0, unsupported = 0;
     
-    // Kích thước và vị trí của hộp thoại
-    int dialog_height = 10;
-    int dialog_width = 50;
-    int dialog_y = (max_y - dialog_height) / 2;
-    int dialog_x = (max_x - dialog_width) / 2;
+    if (bufs == NULL || slot_file == NULL || free_slots == NULL) {
+        free(bufs);
+        free(slot_file);
+        free(free_slots);
+        return -1;
+    }
+    for (int i = 0; i < depth; i++)
+        free_slots[i] = i;
     
-    // Tạo hộp thoại
-    WINDOW *dialog = newwin(dialog_height, dialog_width, dialog_y, dialog_x);
-    wbkgd(dialog, COLOR_PAIR(3));  // Màu nền xanh nhạt
-    box(dialog, 0, 0);
+    while ((next < count && !unsupported) || inflight > 0) {
+        // Giữ hàng đợi luôn đầy
+        while (next < count && free_count > 0 && !unsupported) {
+            struct io_uring_sqe *sqe = io_ring_sqe(r);
+            if (sqe == NULL)
+                break;
+            int slot = free_slots[--free_count];
+            slot_file[slot] = next;
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dfd;
+            sqe->addr = (uint64_t)(uintptr_t)files[next].name;
+            sqe->len = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+            sqe->off = (uint64_t)(uintptr_t)&bufs[slot];
+            sqe->user_data = slot;
+            next++;
+            inflight++;
+        }
+        
+        if (io_ring_submit(r, inflight > 0 ? 1 : 0) != 0) {
+            // Vòng hỏng: luồng này chuyển hẳn sang đường khác. Bộ đệm của các
+            // request có thể vẫn đang bay nên cố ý không giải phóng.
+            thread_ring_failed = 1;
+            return -1;
+        }
+        
+        struct io_uring_cqe *cqe;
+        while ((cqe = io_ring_cqe(r)) != NULL) {
+            int slot = cqe->user_data;
+            FileItem *file = &files[slot_file[slot]];
+            if (cqe->res == 0) {
+                file->is_dir = S_ISDIR(bufs[slot].stx_mode);
+                file->size = bufs[slot].stx_size;
+                file->mtime = bufs[slot].stx_mtime.tv_sec;
+                file->has_stat = 1;
+            } else if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+                unsupported = 1;
+            } else {
+                file->has_stat = 1;  // Giống stat_entry: lỗi thì giữ giá trị cũ
+            }
+            io_ring_cqe_seen(r);
+            free_slots[free_count++] = slot;
+            inflight--;
+        }
+    }
     
-    // Tiêu đề hộp thoại
-    mvwprintw(dialog, 0, (dialog_width - 17) / 2, " Make directory");
+    free(bufs);
+    free(slot_file);
+    free(free_slots);
     
-    // Hiển thị nhãn
-    mvwprintw(dialog, 3, 3, "Nhập tên thư mục:");
+    // Kernel không hỗ trợ STATX: luồng này không thử lại vòng nữa
+    if (unsupported)
+        thread_ring_failed = 1;
+    return unsupported ? -1 : 0;
+}
+
+// Stat một lô entry (tên tương đối với dfd), bỏ qua entry đã có metadata
+void io_stat_batch(int dfd, FileItem *files, int count) {
+    IoRing *r = io_thread_ring();
+    StatTask task = {dfd, files};
     
-    // Tạo ô nhập liệu
-    WINDOW *input_win = newwin(1, 34, dialog_y + 5, dialog_x + 8);
-    wbkgd(input_win, COLOR_PAIR(2));  // Màu khác để nổi bật
-    box(input_win, 0, 0);
+    if (count <= 0)
+        return;
+    if (r != NULL && uring_stat_batch(r, dfd, files, count) == 0)
+        return;
     
-    // Tạo nút OK
-    WINDOW *ok_button = newwin(3, 10, dialog_y + dialog_height - 4, dialog_x + 10);
-    wbkgd(ok_button, COLOR_PAIR(4));  // Màu nút bình thường
-    box(ok_button, 0, 0);
-    mvwprintw(ok_button, 1, 3, "Ok");
+    if (io_backend == IO_BACKEND_SYNC || count < 4) {
+        for (int i = 0; i < count; i++)
+            stat_task(&task, i);
+        return;
+    }
+    io_pool_run(stat_task, &task, count);
+}
+
+// Chép một file theo cách đồng bộ read/write (đường dự phòng của mọi backend)
+int copy_file_sync(CopyJob *job) {
+    unsigned char buf[COPY_CHUNK];
+    int ret = 0;
     
-    // Tạo nút Cancel
-    WINDOW *cancel_button = newwin(3, 10, dialog_y + dialog_height - 4, dialog_x + 30);
-    wbkgd(cancel_button, COLOR_PAIR(4));  // Màu nút bình thường
-    box(cancel_button, 0, 0);
-    mvwprintw(cancel_button, 1, 2, "Cancel");
+    int in = open(job->src, O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return -1;
+    // Không bao giờ ghi đè file có sẵn; chỉ chép lại (O_TRUNC) file chính lô này đã tạo
+    int out = open(job->dst, O_WRONLY | O_CREAT | O_NOFOLLOW | O_CLOEXEC |
+                   (job->created ? O_TRUNC : O_EXCL), job->mode & 0777);
+    if (out < 0) {
+        close(in);
+        return -1;
+    }
+    job->created = 1;
     
-    // Hiển thị dialog và các nút
-    wrefresh(dialog);
-    wrefresh(input_win);
-    wrefresh(ok_button);
-    wrefresh(cancel_button);
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+        if (write_all(out, buf, n) != 0) {
+            ret = -1;
+            break;
+        }
+    }
+    if (n < 0)
+        ret = -1;
     
-    // Chuẩn bị cho việc nhập liệu
-    char dirname[256] = {0};
-    int pos = 0;
-    int ch;
-    int max_input = 32;
+    struct timespec times[2] = {{0, UTIME_OMIT}, {job->mtime, 0}};
+    futimens(out, times);
+    close(in);
+    close(out);
+    return ret;
+}
+
+void copy_task(void *arg, int idx) {
+    CopyJob *jobs = arg;
+    jobs[idx].failed = copy_file_sync(&jobs[idx]) != 0;
+}
+
+void copy_job_finish(CopyJob *job) {
+    if (job->src_fd >= 0)
+        close(job->src_fd);
+    if (job->dst_fd >= 0) {
+        if (!job->failed) {
+            struct timespec times[2] = {{0, UTIME_OMIT}, {job->mtime, 0}};
+            futimens(job->dst_fd, times);
+        }
+        close(job->dst_fd);
+    }
+    job->src_fd = job->dst_fd = -1;
     
-    // Trạng thái focus: 0 = nhập liệu, 1 = nút OK, 2 = nút Cancel
-    int focus_state = 0;
+    // Đọc thiếu (file đổi trong lúc chép): chép lại đồng bộ
+    if (job->failed)
+        job->failed = copy_file_sync(job) != 0;
+}
+
+// Chép lô file qua io_uring: mỗi đoạn là cặp READ -> WRITE nối bằng IOSQE_IO_LINK,
+// nhiều file/đoạn cùng bay để hàng đợi luôn sâu
+int uring_copy_batch(IoRing *r, CopyJob *jobs, int count) {
+    int slots = r->entries / 2;
+    unsigned char *buffers = malloc((size_t)slots * COPY_CHUNK);
+    int *slot_job = malloc(slots * sizeof(int));
+    unsigned *slot_len = malloc(slots * sizeof(unsigned));
+    int *free_slots = malloc(slots * sizeof(int));
+    int free_count = slots, inflight = 0, next_job = 0, cur = -1, unsupported = 0;
     
-    // Khởi tạo focus ban đầu tại ô nhập liệu
-    curs_set(1);  // Hiện con trỏ
-    keypad(input_win, TRUE);
-    keypad(dialog, TRUE);
-    wmove(input_win, 0, 0);
-    wrefresh(input_win);
+    if (buffers == NULL || slot_job == NULL || slot_len == NULL || free_slots == NULL) {
+        free(buffers);
+        free(slot_job);
+        free(slot_len);
+        free(free_slots);
+        return -1;
+    }
+    for (int i = 0; i < slots; i++)
+        free_slots[i] = i;
+    for (int i = 0; i < count; i++) {
+        jobs[i].src_fd = jobs[i].dst_fd = -1;
+        jobs[i].next_offset = 0;
+        jobs[i].pending = 0;
+        jobs[i].failed = 0;
+    }
     
-    // Vòng lặp xử lý nhập liệu và điều hướng
-    while (1) {
-        if (focus_state == 0) {
-            // Đang ở chế độ nhập liệu
-            wmove(input_win, 0, pos);
-            wrefresh(input_win);
-            ch = wgetch(input_win);
-            
-            if (ch == '\n') {
-                // Enter tại ô nhập liệu = OK
-                if (strlen(dirname) > 0) {
-                    // Tạo thư mục
-                    char new_dir_path[MAX_PATH];
-                    snprintf(new_dir_path, MAX_PATH, "%s/%s", p->current_path, dirname);
-                    
-                    if (mkdir(new_dir_path, 0755) == 0) {
-                        read_directory(p);
-                        break;
-                    } else {
-                        mvwprintw(dialog, dialog_height - 2, 2, "Error: Can not create directory!");
-                        wrefresh(dialog);
-                        napms(1500);
-                    }
-                }
-            } else if (ch == KEY_DOWN) {
-                // Chuyển xuống nút OK
-                focus_state = 1;
-                curs_set(0);  // Ẩn con trỏ
-                
-                // Tô vàng nút OK
-                wbkgd(ok_button, COLOR_PAIR(5));  // Màu vàng cho nút được chọn
-                wrefresh(ok_button);
-            } else if (ch == KEY_BACKSPACE || ch == 127) {
-                if (pos > 0) {
-                    // Xóa ký tự
-                    pos--;
-                    dirname[pos] = '\0';
-                    mvwaddch(input_win, 0, pos, ' ');
-                    wmove(input_win, 0, pos);
-                    wrefresh(input_win);
+    for (;;) {
+        while (free_count > 0 && !unsupported) {
+            if (cur < 0 || jobs[cur].next_offset >= jobs[cur].size) {
+                if (next_job >= count)
+                    break;
+                cur = next_job++;
+                CopyJob *job = &jobs[cur];
+                job->src_fd = open(job->src, O_RDONLY | O_CLOEXEC);
+                job->dst_fd = open(job->dst, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                                   job->mode & 0777);
+                job->created = job->dst_fd >= 0;
+                if (job->src_fd < 0 || job->dst_fd < 0 || job->size == 0) {
+                    job->failed = job->src_fd < 0 || job->dst_fd < 0;
+                    copy_job_finish(job);
+                    cur = -1;
                 }
-            } else if (ch == 27) {  // ESC
-                // Hủy và thoát
-                break;
-            } else if (pos < max_input && ch >= 32 && ch <= 126) {
-                // Nhập ký tự bình thường
-                dirname[pos++] = ch;
-                dirname[pos] = '\0';
-                waddch(input_win, ch);
-                wrefresh(input_win);
+                continue;
             }
-        } else if (focus_state == 1) {
-            // Đang ở nút OK
-            ch = wgetch(dialog);
             
-            if (ch == '\n') {
-                // Enter tại nút OK
-                if (strlen(dirname) > 0) {
-                    // Tạo thư mục
-                    char new_dir_path[MAX_PATH];
-                    snprintf(new_dir_path, MAX_PATH, "%s/%s", p->current_path, dirname);
-                    
-                    if (mkdir(new_dir_path, 0755) == 0) {
-                        read_directory(p);
-                        break;
-                    } else {
-                        mvwprintw(dialog, dialog_height - 2, 2, "Lỗi: Không thể tạo thư mục!");
-                        wrefresh(dialog);
-                        napms(1500);
-                    }
-                }
-            } else if (ch == KEY_UP) {
-                // Chuyển lên ô nhập liệu
-                focus_state = 0;
-                curs_set(1);  // Hiển thị con trỏ nhập liệu
-                
-                // Bỏ tô vàng nút OK
-                wbkgd(ok_button, COLOR_PAIR(4));  // Màu mặc định cho nút
-                wrefresh(ok_button);
-                
-                // Focus lại ô nhập liệu
-                wmove(input_win, 0, pos);
-                wrefresh(input_win);
-            } else if (ch == KEY_RIGHT) {
-                // Chuyển sang nút Cancel
-                focus_state = 2;
-                
-                // Đổi màu các nút
-                wbkgd(ok_button, COLOR_PAIR(4));  // Màu mặc định
-                wbkgd(cancel_button, COLOR_PAIR(5));  // Màu vàng
-                wrefresh(ok_button);
-                wrefresh(cancel_button);
-            } else if (ch == 27) {  // ESC
-                // Hủy và thoát
+            CopyJob *job = &jobs[cur];
+            struct io_uring_sqe *rd = io_ring_sqe(r);
+            struct io_uring_sqe *wr = rd ? io_ring_sqe(r) : NULL;
+            if (wr == NULL)
                 break;
-            }
-        } else if (focus_state == 2) {
-            // Đang ở nút Cancel
-            ch = wgetch(dialog);
             
-            if (ch == '\n' || ch == 27) {
-                // Enter hoặc ESC tại nút Cancel = thoát
+            int slot = free_slots[--free_count];
+            off_t left = job->size - job->next_offset;
+            unsigned len = left < COPY_CHUNK ? (unsigned)left : COPY_CHUNK;
+            unsigned char *buf = buffers + (size_t)slot * COPY_CHUNK;
+            
+            rd->opcode = IORING_OP_READ;
+            rd->fd = job->src_fd;
+            rd->addr = (uint64_t)(uintptr_t)buf;
+            rd->len = len;
+            rd->off = job->next_offset;
+            rd->flags = IOSQE_IO_LINK;
+            rd->user_data = (uint64_t)slot * 2;
+            
+            wr->opcode = IORING_OP_WRITE;
+            wr->fd = job->dst_fd;
+            wr->addr = (uint64_t)(uintptr_t)buf;
+            wr->len = len;
+            wr->off = job->next_offset;
+            wr->user_data = (uint64_t)slot * 2 + 1;
+            
+            slot_job[slot] = cur;
+            slot_len[slot] = len;
+            job->next_offset += len;
+            job->pending++;
+            inflight++;
+        }
+        
+        if (inflight == 0)
+            break;
+        if (io_ring_submit(r, 1) != 0) {
+            // Vòng hỏng: đóng fd, để người gọi chép lại cả lô bằng đường khác.
+            // Bộ đệm có thể vẫn được kernel dùng nên cố ý không giải phóng.
+            thread_ring_failed = 1;
+            for (int i = 0; i < next_job; i++) {
+                if (jobs[i].src_fd >= 0)
+                    close(jobs[i].src_fd);
+                if (jobs[i].dst_fd >= 0)
+                    close(jobs[i].dst_fd);
+            }
+            return -1;
+        }
+        
+        struct io_uring_cqe *cqe;
+        while ((cqe = io_ring_cqe(r)) != NULL) {
+            int slot = cqe->user_data / 2;
+            CopyJob *job = &jobs[slot_job[slot]];
+            
+            // Đọc thiếu làm đứt chuỗi, WRITE đi kèm sẽ về với -ECANCELED
+            if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP)
+                unsupported = 1;
+            if (cqe->res != (int)slot_len[slot])
+                job->failed = 1;
+            if (cqe->user_data & 1) {
+                free_slots[free_count++] = slot;
+                inflight--;
+                if (--job->pending == 0 && job->next_offset >= job->size && !unsupported)
+                    copy_job_finish(job);
+            }
+            io_ring_cqe_seen(r);
+        }
+    }
+    
+    free(buffers);
+    free(slot_job);
+    free(slot_len);
+    free(free_slots);
+    
+    // Kernel không hỗ trợ READ/WRITE: không chép lại từng file trên luồng gọi (luồng UI),
+    // báo người gọi chép cả lô qua pool và không dùng vòng của luồng này nữa
+    if (unsupported) {
+        thread_ring_failed = 1;
+        for (int i = 0; i < next_job; i++) {
+            if (jobs[i].src_fd >= 0)
+                close(jobs[i].src_fd);
+            if (jobs[i].dst_fd >= 0)
+                close(jobs[i].dst_fd);
+            jobs[i].src_fd = jobs[i].dst_fd = -1;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Chép một lô file, trả về số file lỗi
+int io_copy_batch(CopyJob *jobs, int count) {
+    IoRing *r = io_thread_ring();
+    int errors = 0;
+    
+    if (r != NULL && uring_copy_batch(r, jobs, count) == 0) {
+        // đã xong
+    } else if (io_backend == IO_BACKEND_SYNC) {
+        for (int i = 0; i < count; i++)
+            copy_task(jobs, i);
+    } else {
+        io_pool_run(copy_task, jobs, count);
+    }
+    
+    for (int i = 0; i < count; i++)
+        errors += jobs[i].failed;
+    return errors;
+}
+
+int has_suffix(const char *name, const char *suffix) {
+    size_t len = strlen(name), slen = strlen(suffix);
+    return len > slen && strcasecmp(name + len - slen, suffix) == 0;
+}
+
+// Nhận dạng archive theo phần mở rộng, -1 nếu không phải archive
+int archive_type(const char *name) {
+    if (has_suffix(name, ".zip"))
+        return ARCHIVE_ZIP;
+    if (has_suffix(name, ".tar"))
+        return ARCHIVE_TAR;
+    if (has_suffix(name, ".tar.gz") || has_suffix(name, ".tgz"))
+        return ARCHIVE_TGZ;
+    return -1;
+}
+
+uint16_t rd16(const unsigned char *b) { return b[0] | b[1] << 8; }
+uint32_t rd32(const unsigned char *b) { return rd16(b) | (uint32_t)rd16(b + 2) << 16; }
+uint64_t rd64(const unsigned char *b) { return rd32(b) | (uint64_t)rd32(b + 4) << 32; }
+
+// Thêm member vào index (gọi khi đang giữ a->lock hoặc trước khi index được chia sẻ)
+ArchiveMember *add_member(Archive *a, const char *path, int is_dir) {
+    char clean[MAX_PATH];
+    
+    // Chuẩn hoá: bỏ "/" và "./" ở đầu, "/" ở cuối đánh dấu thư mục
+    while (path[0] == '/' || (path[0] == '.' && path[1] == '/'))
+        path += path[0] == '/' ? 1 : 2;
+    snprintf(clean, sizeof(clean), "%s", path);
+    size_t len = strlen(clean);
+    while (len > 0 && clean[len - 1] == '/') {
+        clean[--len] = '\0';
+        is_dir = 1;
+    }
+    // Member có thành phần ".." không được index: nó sẽ hiện thành một dòng ".." thứ hai
+    // và giải nén ra ngoài thư mục đích
+    if (len == 0 || !path_is_safe(clean))
+        return NULL;
+    
+    if (a->member_count == a->member_capacity) {
+        int new_capacity = a->member_capacity ? a->member_capacity * 2 : 256;
+        ArchiveMember *members = realloc(a->members, new_capacity * sizeof(ArchiveMember));
+        if (members == NULL)
+            return NULL;
+        a->members = members;
+        a->member_capacity = new_capacity;
+    }
+    
+    char *copy = store_name(&a->names, clean);
+    if (copy == NULL)
+        return NULL;
+    
+    ArchiveMember *m = &a->members[a->member_count++];
+    memset(m, 0, sizeof(*m));
+    m->path = copy;
+    m->is_dir = is_dir;
+    return m;
+}
+
+time_t dos_to_time(uint16_t date, uint16_t time_of_day) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = ((date >> 9) & 0x7f) + 80;
+    tm.tm_mon = ((date >> 5) & 0x0f) - 1;
+    tm.tm_mday = date & 0x1f;
+    tm.tm_hour = time_of_day >> 11;
+    tm.tm_min = (time_of_day >> 5) & 0x3f;
+    tm.tm_sec = (time_of_day & 0x1f) * 2;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// Đọc central directory của zip qua mmap (không cần luồng nền)
+int zip_read_index(Archive *a) {
+    int fd = open(a->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    if (a->file_size < 22) {
+        close(fd);
+        return -1;
+    }
+    
+    void *map = mmap(NULL, a->file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    a->map = map;
+    a->map_size = a->file_size;
+    
+    const unsigned char *m = a->map;
+    off_t size = a->file_size;
+    
+    // Tìm End of Central Directory từ cuối file (comment tối đa 64K)
+    off_t eocd = -1;
+    for (off_t i = size - 22; i >= 0 && i >= size - 22 - 65535; i--) {
+        if (rd32(m + i) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0)
+        return -1;
+    
+    uint64_t count = rd16(m + eocd + 10);
+    uint64_t cd_offset = rd32(m + eocd + 16);
+    
+    // ZIP64: số entry hoặc offset không vừa 16/32 bit
+    if ((count == 0xFFFF || cd_offset == 0xFFFFFFFF) && eocd >= 20 &&
+        rd32(m + eocd - 20) == 0x07064b50) {
+        uint64_t z64 = rd64(m + eocd - 20 + 8);
+        if (z64 + 56 <= (uint64_t)size && rd32(m + z64) == 0x06064b50) {
+            count = rd64(m + z64 + 32);
+            cd_offset = rd64(m + z64 + 48);
+        }
+    }
+    
+    madvise(a->map + (cd_offset < (uint64_t)size ? cd_offset : 0),
+            size - (cd_offset < (uint64_t)size ? cd_offset : 0), MADV_SEQUENTIAL);
+    
+    uint64_t pos = cd_offset;
+    for (uint64_t i = 0; i < count; i++) {
+        if (pos + 46 > (uint64_t)size || rd32(m + pos) != 0x02014b50)
+            break;
+        
+        int method = rd16(m + pos + 10);
+        uint16_t dos_time = rd16(m + pos + 12);
+        uint16_t dos_date = rd16(m + pos + 14);
+        uint64_t comp_size = rd32(m + pos + 20);
+        uint64_t uncomp_size = rd32(m + pos + 24);
+        int name_len = rd16(m + pos + 28);
+        int extra_len = rd16(m + pos + 30);
+        int comment_len = rd16(m + pos + 32);
+        uint64_t local_offset = rd32(m + pos + 42);
+        if (pos + 46 + name_len + extra_len + comment_len > (uint64_t)size)
+            break;
+        
+        // Trường extra ZIP64 chỉ chứa những giá trị bị tràn, theo thứ tự cố định
+        const unsigned char *x = m + pos + 46 + name_len;
+        const unsigned char *x_end = x + extra_len;
+        while (x + 4 <= x_end) {
+            int id = rd16(x), len = rd16(x + 2);
+            const unsigned char *q = x + 4, *q_end = q + len;
+            if (q_end > x_end)
+                break;
+            if (id == 0x0001) {
+                if (uncomp_size == 0xFFFFFFFF && q + 8 <= q_end) {
+                    uncomp_size = rd64(q);
+                    q += 8;
+                }
+                if (comp_size == 0xFFFFFFFF && q + 8 <= q_end) {
+                    comp_size = rd64(q);
+                    q += 8;
+                }
+                if (local_offset == 0xFFFFFFFF && q + 8 <= q_end)
+                    local_offset = rd64(q);
+            }
+            x = q_end;
+        }
+        
+        char name[MAX_PATH];
+        int copy_len = name_len < MAX_PATH - 1 ? name_len : MAX_PATH - 1;
+        memcpy(name, m + pos + 46, copy_len);
+        name[copy_len] = '\0';
+        
+        ArchiveMember *member = add_member(a, name, 0);
+        if (member != NULL) {
+            // Tạo trên Unix: 16 bit cao của thuộc tính ngoài là st_mode
+            if (m[pos + 5] == 3 && !member->is_dir) {
+                mode_t mode = rd32(m + pos + 38) >> 16;
+                if (S_ISLNK(mode))
+                    member->kind = ENTRY_SYMLINK;
+                else if (mode != 0 && !S_ISREG(mode) && !S_ISDIR(mode))
+                    member->kind = ENTRY_SPECIAL;
+            }
+            member->size = uncomp_size;
+            member->comp_size = comp_size;
+            member->offset = local_offset;
+            member->method = method;
+            member->mtime = dos_to_time(dos_date, dos_time);
+        }
+        
+        pos += 46 + name_len + extra_len + comment_len;
+    }
+    
+    return 0;
+}
+
+// Trạng thái quét header tar trên luồng byte (dùng cho cả tar thường và tar.gz)
+typedef struct {
+    off_t pos;               // Vị trí hiện tại trong luồng tar
+    off_t next_header;       // Vị trí header kế tiếp
+    unsigned char header[512];
+    size_t header_fill;
+    char *extra;             // Dữ liệu của entry 'L'/'K' (tên dài GNU) hoặc 'x' (pax)
+    size_t extra_fill;
+    size_t extra_size;
+    char extra_type;
+    char long_name[MAX_PATH];  // Tên cho entry kế tiếp lấy từ 'L' hoặc pax path=
+    char long_link[MAX_PATH];  // Đích link cho entry kế tiếp lấy từ 'K' hoặc pax linkpath=
+    off_t pax_size;            // Kích thước từ pax size=, -1 nếu không có
+    int done;
+} TarScanner;
+
+off_t tar_number(const unsigned char *field, int len) {
+    off_t value = 0;
+    
+    // Kiểu base-256 của GNU cho số lớn
+    if (field[0] & 0x80) {
+        value = field[0] & 0x7f;
+        for (int i = 1; i < len; i++)
+            value = (value << 8) | field[i];
+        return value;
+    }
+    
+    int i = 0;
+    while (i < len && (field[i] == ' ' || field[i] == '\0'))
+        i++;
+    while (i < len && field[i] >= '0' && field[i] <= '7')
+        value = value * 8 + (field[i++] - '0');
+    return value;
+}
+
+void tar_finish_extra(TarScanner *t) {
+    t->extra[t->extra_fill] = '\0';
+    
+    if (t->extra_type == 'L') {
+        snprintf(t->long_name, sizeof(t->long_name), "%s", t->extra);
+    } else if (t->extra_type == 'K') {
+        snprintf(t->long_link, sizeof(t->long_link), "%s", t->extra);
+    } else {
+        // Bản ghi pax: "<độ dài> <khoá>=<giá trị>\n"
+        char *rec = t->extra;
+        char *end = t->extra + t->extra_fill;
+        while (rec < end) {
+            char *space;
+            long rec_len = strtol(rec, &space, 10);
+            if (rec_len <= 0 || rec + rec_len > end || *space != ' ')
+                break;
+            char *key = space + 1;
+            char *value_end = rec + rec_len - 1;  // Ký tự '\n'
+            if (strncmp(key, "path=", 5) == 0) {
+                int len = value_end - (key + 5);
+                if (len >= MAX_PATH)
+                    len = MAX_PATH - 1;
+                memcpy(t->long_name, key + 5, len);
+                t->long_name[len] = '\0';
+            } else if (strncmp(key, "linkpath=", 9) == 0) {
+                int len = value_end - (key + 9);
+                if (len >= MAX_PATH)
+                    len = MAX_PATH - 1;
+                memcpy(t->long_link, key + 9, len);
+                t->long_link[len] = '\0';
+            } else if (strncmp(key, "size=", 5) == 0) {
+                t->pax_size = strtoll(key + 5, NULL, 10);
+            }
+            rec += rec_len;
+        }
+    }
+    
+    free(t->extra);
+    t->extra = NULL;
+}
+
+void tar_header(Archive *a, TarScanner *t) {
+    const unsigned char *h = t->header;
+    
+    // Khối toàn số 0 đánh dấu hết archive
+    int zero = 1;
+    for (int i = 0; i < 512 && zero; i++)
+        zero = h[i] == 0;
+    if (zero) {
+        t->done = 1;
+        return;
+    }
+    
+    unsigned sum = 0;
+    for (int i = 0; i < 512; i++)
+        sum += (i >= 148 && i < 156) ? ' ' : h[i];
+    if (sum != (unsigned)tar_number(h + 148, 8)) {
+        t->done = 1;
+        a->index_error = 1;
+        return;
+    }
+    
+    off_t size = tar_number(h + 124, 12);
+    char type = h[156];
+    t->next_header = t->pos + ((size + 511) & ~(off_t)511);
+    
+    if (type == 'L' || type == 'K' || type == 'x') {
+        t->extra_type = type;
+        t->extra_size = size < TAR_EXTRA_MAX ? size : TAR_EXTRA_MAX;
+        t->extra_fill = 0;
+        t->extra = malloc(t->extra_size + 1);
+        if (t->extra != NULL && t->extra_size == 0)
+            tar_finish_extra(t);
+        return;
+    }
+    if (type == 'g')
+        return;
+    
+    char name[MAX_PATH];
+    if (t->long_name[0] != '\0') {
+        snprintf(name, sizeof(name), "%s", t->long_name);
+        t->long_name[0] = '\0';
+    } else if (memcmp(h + 257, "ustar", 5) == 0 && h[345] != '\0') {
+        snprintf(name, sizeof(name), "%.155s/%.100s", (const char *)h + 345, (const char *)h);
+    } else {
+        snprintf(name, sizeof(name), "%.100s", (const char *)h);
+    }
+    if (t->pax_size >= 0) {
+        size = t->pax_size;
+        t->next_header = t->pos + ((size + 511) & ~(off_t)511);
+        t->pax_size = -1;
+    }
+    
+    char link[MAX_PATH];
+    if (t->long_link[0] != '\0') {
+        snprintf(link, sizeof(link), "%s", t->long_link);
+        t->long_link[0] = '\0';
+    } else {
+        snprintf(link, sizeof(link), "%.100s", (const char *)h + 157);
+    }
+    
+    pthread_mutex_lock(&a->lock);
+    ArchiveMember *m = add_member(a, name, type == '5');
+    if (m != NULL) {
+        m->size = m->is_dir ? 0 : size;
+        m->mtime = tar_number(h + 136, 12);
+        m->offset = t->pos;
+        // '0', '\0' và '7' (contiguous) là file thường; còn lại là link hoặc file đặc biệt
+        if (type == '2' || type == '1') {
+            m->kind = type == '2' ? ENTRY_SYMLINK : ENTRY_HARDLINK;
+            m->link = store_name(&a->names, link);
+            m->size = 0;
+        } else if (!m->is_dir && type != '0' && type != '\0' && type != '7') {
+            m->kind = ENTRY_SPECIAL;
+        }
+    }
+    int count = a->member_count;
+    pthread_mutex_unlock(&a->lock);
+    
+    if (count % 1024 == 0)
+        wake_main_loop();
+}
+
+// Đưa một đoạn của luồng tar vào bộ quét
+void tar_feed(Archive *a, TarScanner *t, const unsigned char *buf, size_t len) {
+    while (len > 0 && !t->done) {
+        if (t->pos < t->next_header) {
+            size_t n = t->next_header - t->pos < (off_t)len ? (size_t)(t->next_header - t->pos) : len;
+            if (t->extra != NULL && t->extra_fill < t->extra_size) {
+                size_t k = t->extra_size - t->extra_fill < n ? t->extra_size - t->extra_fill : n;
+                memcpy(t->extra + t->extra_fill, buf, k);
+                t->extra_fill += k;
+            }
+            t->pos += n;
+            buf += n;
+            len -= n;
+            if (t->pos == t->next_header && t->extra != NULL)
+                tar_finish_extra(t);
+            continue;
+        }
+        
+        size_t n = 512 - t->header_fill < len ? 512 - t->header_fill : len;
+        memcpy(t->header + t->header_fill, buf, n);
+        t->header_fill += n;
+        t->pos += n;
+        buf += n;
+        len -= n;
+        if (t->header_fill == 512) {
+            t->header_fill = 0;
+            t->next_header = t->pos;
+            tar_header(a, t);
+        }
+    }
+}
+
+// tar không nén: chỉ đọc header, nhảy qua dữ liệu bằng offset
+void tar_index_plain(Archive *a, TarScanner *t, int fd) {
+    unsigned char buf[GZ_CHUNK];
+    
+    while (!t->done && !a->stop) {
+        if (t->pos < t->next_header && t->extra == NULL)
+            t->pos = t->next_header;
+        size_t want = 512;
+        if (t->pos < t->next_header)
+            want = t->next_header - t->pos < (off_t)sizeof(buf) ? (size_t)(t->next_header - t->pos) : sizeof(buf);
+        ssize_t n = pread(fd, buf, want, t->pos);
+        if (n <= 0)
+            break;
+        tar_feed(a, t, buf, n);
+    }
+}
+
+void add_point(Archive *a, z_stream *strm, const unsigned char *window, off_t in, off_t out) {
+    pthread_mutex_lock(&a->lock);
+    if (a->point_count == a->point_capacity) {
+        int new_capacity = a->point_capacity ? a->point_capacity * 2 : 16;
+        GzPoint *points = realloc(a->points, new_capacity * sizeof(GzPoint));
+        if (points == NULL) {
+            pthread_mutex_unlock(&a->lock);
+            return;
+        }
+        a->points = points;
+        a->point_capacity = new_capacity;
+    }
+    
+    GzPoint *pt = &a->points[a->point_count++];
+    pt->out = out;
+    pt->in = in;
+    pt->bits = strm->data_type & 7;
+    
+    // Cửa sổ vòng: phần cũ nằm sau next_out, phần mới nằm ở đầu bộ đệm
+    unsigned left = strm->avail_out;
+    if (left)
+        memcpy(pt->window, window + GZ_WINSIZE - left, left);
+    if (left < GZ_WINSIZE)
+        memcpy(pt->window + left, window, GZ_WINSIZE - left);
+    pthread_mutex_unlock(&a->lock);
+}
+
+// tar.gz: giải nén tuần tự một lần, vừa quét header tar vừa đặt checkpoint mỗi GZ_SPAN byte
+void tar_index_gzip(Archive *a, TarScanner *t, int fd) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 47) != Z_OK)  // 32 + 15: tự nhận dạng header gzip
+        return;
+    
+    unsigned char *in = malloc(GZ_CHUNK);
+    unsigned char *window = calloc(1, GZ_WINSIZE);
+    off_t total_in = 0, total_out = 0, last = 0;
+    int have_point = 0;
+    
+    while (in != NULL && window != NULL && !t->done && !a->stop) {
+        if (strm.avail_in == 0) {
+            ssize_t n = read(fd, in, GZ_CHUNK);
+            if (n <= 0)
+                break;
+            strm.avail_in = n;
+            strm.next_in = in;
+        }
+        if (strm.avail_out == 0) {
+            strm.avail_out = GZ_WINSIZE;
+            strm.next_out = window;
+        }
+        
+        unsigned char *out_start = strm.next_out;
+        unsigned avail_in = strm.avail_in;
+        int ret = inflate(&strm, Z_BLOCK);
+        total_in += avail_in - strm.avail_in;
+        total_out += strm.next_out - out_start;
+        tar_feed(a, t, out_start, strm.next_out - out_start);
+        
+        if (ret == Z_STREAM_END) {
+            // Nhiều member gzip nối tiếp nhau: tiếp tục với member sau
+            inflateReset(&strm);
+            continue;
+        }
+        if (ret != Z_OK) {
+            a->index_error = 1;
+            break;
+        }
+        
+        // Chỉ đặt checkpoint ở ranh giới block deflate
+        if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+            (!have_point || total_out - last >= GZ_SPAN)) {
+            add_point(a, &strm, window, total_in, total_out);
+            last = total_out;
+            have_point = 1;
+        }
+    }
+    
+    inflateEnd(&strm);
+    free(in);
+    free(window);
+}
+
+// ---- Index tar/tar.gz lưu xuống đĩa ----
+// Index dựng xong của archive lớn được ghi vào ~/.cache/file_manager/index-<dev>-<ino> để lần
+// chạy sau không phải giải nén lại cả file: header, rồi từng member (bản ghi cố định + đường
+// dẫn + đích link), rồi các checkpoint gzip. File không khớp (mtime/size đổi) thì bị bỏ qua
+// và ghi đè khi index lại.
+
+typedef struct {
+    char magic[8];
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime;
+    int64_t file_size;
+    uint32_t type;
+    uint32_t member_count;
+    uint32_t point_count;
+    uint32_t reserved;
+} IndexHeader;
+
+typedef struct {
+    int64_t size;
+    int64_t mtime;
+    int64_t offset;
+    uint32_t path_len;        // Không kể NUL
+    uint32_t link_len;        // 0 nếu không có link
+    uint32_t is_dir;
+    uint32_t kind;
+} IndexMember;
+
+typedef struct {
+    int64_t out;
+    int64_t in;
+    uint32_t bits;
+    uint32_t reserved;
+} IndexPoint;                 // Theo sau là GZ_WINSIZE byte cửa sổ
+
+int index_path(Archive *a, char *buf, size_t size, int create) {
+    char name[64];
+    snprintf(name, sizeof(name), "index-%llx-%llx", (unsigned long long)a->dev, (unsigned long long)a->ino);
+    return state_path(buf, size, "XDG_CACHE_HOME", ".cache", name, create);
+}
+
+// Gọi từ luồng index sau khi index xong: không còn ai ghi vào members/points
+void index_save(Archive *a) {
+    char path[MAX_PATH], tmp[MAX_PATH + 8];
+    IndexHeader h;
+    
+    if (a->file_size < INDEX_CACHE_MIN || index_path(a, path, sizeof(path), 1) != 0)
+        return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL)
+        return;
+    
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, 8);
+    h.dev = a->dev;
+    h.ino = a->ino;
+    h.mtime = a->mtime;
+    h.file_size = a->file_size;
+    h.type = a->type;
+    h.member_count = a->member_count;
+    h.point_count = a->point_count;
+    fwrite(&h, sizeof(h), 1, f);
+    
+    for (int i = 0; i < a->member_count; i++) {
+        ArchiveMember *m = &a->members[i];
+        IndexMember e;
+        memset(&e, 0, sizeof(e));
+        e.size = m->size;
+        e.mtime = m->mtime;
+        e.offset = m->offset;
+        e.path_len = strlen(m->path);
+        e.link_len = m->link ? strlen(m->link) : 0;
+        e.is_dir = m->is_dir;
+        e.kind = m->kind;
+        fwrite(&e, sizeof(e), 1, f);
+        fwrite(m->path, 1, e.path_len, f);
+        if (e.link_len)
+            fwrite(m->link, 1, e.link_len, f);
+    }
+    for (int i = 0; i < a->point_count; i++) {
+        IndexPoint e;
+        memset(&e, 0, sizeof(e));
+        e.out = a->points[i].out;
+        e.in = a->points[i].in;
+        e.bits = a->points[i].bits;
+        fwrite(&e, sizeof(e), 1, f);
+        fwrite(a->points[i].window, 1, GZ_WINSIZE, f);
+    }
+    
+    int failed = ferror(f);
+    if (fclose(f) != 0 || failed)
+        unlink(tmp);
+    else
+        rename(tmp, path);
+}
+
+// Nạp index đã lưu vào archive chưa được chia sẻ; trả về 0 nếu dùng được
+int index_load(Archive *a) {
+    char path[MAX_PATH], name[MAX_PATH], link[MAX_PATH];
+    IndexHeader h;
+    int ok = 0;
+    
+    if (a->file_size < INDEX_CACHE_MIN || index_path(a, path, sizeof(path), 0) != 0)
+        return -1;
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return -1;
+    
+    if (fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, INDEX_MAGIC, 8) == 0 &&
+        h.dev == (uint64_t)a->dev && h.ino == (uint64_t)a->ino && h.mtime == a->mtime &&
+        h.file_size == a->file_size && h.type == (uint32_t)a->type && h.member_count < INT_MAX / 2 &&
+        h.point_count < INT_MAX / 2) {
+        ok = 1;
+        for (uint32_t i = 0; ok && i < h.member_count; i++) {
+            IndexMember e;
+            ok = fread(&e, sizeof(e), 1, f) == 1 && e.path_len < MAX_PATH && e.link_len < MAX_PATH &&
+                 fread(name, 1, e.path_len, f) == e.path_len &&
+                 fread(link, 1, e.link_len, f) == e.link_len;
+            if (!ok)
+                break;
+            name[e.path_len] = '\0';
+            link[e.link_len] = '\0';
+            ArchiveMember *m = add_member(a, name, e.is_dir != 0);
+            if (m == NULL || (e.link_len && (m->link = store_name(&a->names, link)) == NULL)) {
+                ok = 0;
                 break;
-            } else if (ch == KEY_UP) {
-                // Chuyển lên ô nhập liệu
-                focus_state = 0;
-                curs_set(1);  // Hiển thị con trỏ nhập liệu
-                
-                // Bỏ tô vàng nút Cancel
-                wbkgd(cancel_button, COLOR_PAIR(4));  // Màu mặc định cho nút
-                wrefresh(cancel_button);
-                
-                // Focus lại ô nhập liệu
-                wmove(input_win, 0, pos);
-                wrefresh(input_win);
-            } else if (ch == KEY_LEFT) {
-                // Chuyển sang nút OK
-                focus_state = 1;
-                
-                // Đổi màu các nút
-                wbkgd(cancel_button, COLOR_PAIR(4));  // Màu mặc định
-                wbkgd(ok_button, COLOR_PAIR(5));  // Màu vàng
-                wrefresh(cancel_button);
-                wrefresh(ok_button);
             }
+            m->size = e.size;
+            m->mtime = e.mtime;
+            m->offset = e.offset;
+            m->kind = e.kind;
+        }
+        
+        if (ok && h.point_count > 0) {
+            a->points = malloc(h.point_count * sizeof(GzPoint));
+            ok = a->points != NULL;
+            if (ok)
+                a->point_capacity = h.point_count;
+        }
+        for (uint32_t i = 0; ok && i < h.point_count; i++) {
+            IndexPoint e;
+            GzPoint *pt = &a->points[i];
+            ok = fread(&e, sizeof(e), 1, f) == 1 && e.bits < 8 &&
+                 fread(pt->window, 1, GZ_WINSIZE, f) == GZ_WINSIZE;
+            pt->out = e.out;
+            pt->in = e.in;
+            pt->bits = e.bits;
+            a->point_count++;
+        }
+    }
+    fclose(f);
+    
+    // Hỏng giữa chừng: bỏ phần đã nạp để dựng lại index từ đầu
+    if (!ok) {
+        a->member_count = 0;
+        a->point_count = 0;
+        while (a->names != NULL) {
+            NameBlock *next = a->names->next;
+            free(a->names);
+            a->names = next;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+void *archive_indexer(void *arg) {
+    Archive *a = arg;
+    TarScanner t;
+    
+    memset(&t, 0, sizeof(t));
+    t.pax_size = -1;
+    
+    int fd = open(a->path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        if (a->type == ARCHIVE_TAR)
+            tar_index_plain(a, &t, fd);
+        else
+            tar_index_gzip(a, &t, fd);
+        close(fd);
+    }
+    free(t.extra);
+    
+    pthread_mutex_lock(&a->lock);
+    a->indexing = 0;
+    if (fd < 0)
+        a->index_error = 1;
+    int complete = !a->stop && !a->index_error;
+    pthread_mutex_unlock(&a->lock);
+    wake_main_loop();
+    
+    if (complete)
+        index_save(a);
+    return NULL;
+}
+
+void free_archive(Archive *a) {
+    if (a->indexer_running) {
+        a->stop = 1;
+        pthread_join(a->indexer, NULL);
+    }
+    if (a->map != NULL)
+        munmap(a->map, a->map_size);
+    while (a->names != NULL) {
+        NameBlock *next = a->names->next;
+        free(a->names);
+        a->names = next;
+    }
+    free(a->members);
+    free(a->points);
+    pthread_mutex_destroy(&a->lock);
+    free(a);
+}
+
+// Mở archive, dùng lại index đã có trong cache nếu file chưa thay đổi
+Archive *open_archive(const char *path) {
+    struct stat st;
+    int type = archive_type(path);
+    int slot = -1;
+    
+    if (type < 0 || stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return NULL;
+    
+    for (int i = 0; i < ARCHIVE_CACHE_MAX; i++) {
+        Archive *a = archive_cache[i];
+        if (a != NULL && a->dev == st.st_dev && a->ino == st.st_ino &&
+            a->mtime == st.st_mtime && a->file_size == st.st_size) {
+            a->refs++;
+            return a;
+        }
+    }
+    
+    // Chọn ô trống, hoặc bỏ archive không còn panel nào dùng
+    for (int i = 0; i < ARCHIVE_CACHE_MAX && slot < 0; i++) {
+        if (archive_cache[i] == NULL)
+            slot = i;
+    }
+    for (int i = 0; i < ARCHIVE_CACHE_MAX && slot < 0; i++) {
+        if (archive_cache[i]->refs == 0) {
+            free_archive(archive_cache[i]);
+            archive_cache[i] = NULL;
+            slot = i;
+        }
+    }
+    
+    Archive *a = calloc(1, sizeof(Archive));
+    if (a == NULL)
+        return NULL;
+    snprintf(a->path, sizeof(a->path), "%s", path);
+    a->type = type;
+    a->dev = st.st_dev;
+    a->ino = st.st_ino;
+    a->mtime = st.st_mtime;
+    a->file_size = st.st_size;
+    a->refs = 1;
+    pthread_mutex_init(&a->lock, NULL);
+    
+    if (type == ARCHIVE_ZIP) {
+        if (zip_read_index(a) != 0) {
+            free_archive(a);
+            return NULL;
+        }
+    } else if (index_load(a) != 0) {
+        // tar/tar.gz: index được dựng ở nền, listing hiện dần khi tìm thấy member
+        a->indexing = 1;
+        if (pthread_create(&a->indexer, NULL, archive_indexer, a) == 0) {
+            a->indexer_running = 1;
+        } else {
+            free_archive(a);
+            return NULL;
+        }
+    }
+    
+    if (slot >= 0)
+        archive_cache[slot] = a;
+    return a;
+}
+
+void release_archive(Archive *a) {
+    a->refs--;
+    
+    // Archive không vào được cache thì giải phóng ngay
+    for (int i = 0; i < ARCHIVE_CACHE_MAX; i++) {
+        if (archive_cache[i] == a)
+            return;
+    }
+    if (a->refs == 0)
+        free_archive(a);
+}
+
+void close_archives() {
+    for (int i = 0; i < ARCHIVE_CACHE_MAX; i++) {
+        if (archive_cache[i] != NULL) {
+            free_archive(archive_cache[i]);
+            archive_cache[i] = NULL;
+        }
+    }
+}
+
+// Dựng listing cho thư mục archive_prefix từ index của archive
+void read_archive_dir(FilePanel *p) {
+    Archive *a = p->archive;
+    size_t prefix_len = strlen(p->archive_prefix);
+    char name[256];
+    FileItem *file;
+    
+    pthread_mutex_lock(&a->lock);
+    for (int i = 0; i < a->member_count; i++) {
+        ArchiveMember *m = &a->members[i];
+        if (strncmp(m->path, p->archive_prefix, prefix_len) != 0 || m->path[prefix_len] == '\0')
+            continue;
+        
+        const char *rest = m->path + prefix_len;
+        const char *slash = strchr(rest, '/');
+        size_t len = slash ? (size_t)(slash - rest) : strlen(rest);
+        if (len >= sizeof(name))
+            len = sizeof(name) - 1;
+        memcpy(name, rest, len);
+        name[len] = '\0';
+        
+        // Member nằm sâu hơn: thư mục ngầm định, member liên tiếp thường cùng thư mục
+        if (slash != NULL) {
+            FileItem *last = &p->files[p->file_count - 1];
+            if (last->is_dir && strcmp(last->name, name) == 0)
+                continue;
+            if ((file = append_file(p, name)) == NULL)
+                break;
+            file->is_dir = 1;
+            continue;
+        }
+        
+        if ((file = append_file(p, name)) == NULL)
+            break;
+        file->is_dir = m->is_dir;
+        file->size = m->size;
+        file->mtime = m->mtime;
+        file->kind = m->kind;
+        file->has_stat = 1;
+    }
+    p->listed_members = a->member_count;
+    p->archive_indexing = a->indexing;
+    pthread_mutex_unlock(&a->lock);
+    p->listed_at = now_ms();
+    
+    sort_files(p);
+    
+    // Bỏ trùng thư mục, ưu tiên entry có metadata thật
+    int out = 1;
+    for (int i = 1; i < p->file_count; i++) {
+        FileItem *prev = &p->files[out - 1];
+        if (out > 1 && prev->is_dir == p->files[i].is_dir && strcmp(prev->name, p->files[i].name) == 0) {
+            if (p->files[i].has_stat)
+                *prev = p->files[i];
+            continue;
+        }
+        p->files[out++] = p->files[i];
+    }
+    p->file_count = out;
+}
+
+// Archive đang index đã có thêm member hoặc vừa index xong
+int archive_changed(FilePanel *p) {
+    if (p->archive == NULL || !p->archive_indexing)
+        return 0;
+    
+    pthread_mutex_lock(&p->archive->lock);
+    int indexing = p->archive->indexing;
+    int changed = p->archive->member_count != p->listed_members || !indexing;
+    pthread_mutex_unlock(&p->archive->lock);
+    
+    if (changed && indexing && now_ms() - p->listed_at < ARCHIVE_RELIST_MS)
+        return 0;
+    return changed;
+}
+
+// Enter trên file archive hoặc bên trong archive
+void enter_archive(FilePanel *p, const char *name, int is_dir) {
+    if (p->archive == NULL) {
+        char path[MAX_PATH];
+        if (p->current_path[strlen(p->current_path) - 1] == '/')
+            snprintf(path, sizeof(path), "%s%s", p->current_path, name);
+        else
+            snprintf(path, sizeof(path), "%s/%s", p->current_path, name);
+        
+        Archive *a = open_archive(path);
+        if (a == NULL)
+            return;
+        p->archive = a;
+        p->archive_prefix[0] = '\0';
+        strcpy(p->current_path, path);
+    } else if (strcmp(name, "..") == 0) {
+        char *last_slash = strrchr(p->current_path, '/');
+        char previous[256];
+        snprintf(previous, sizeof(previous), "%s", last_slash ? last_slash + 1 : p->current_path);
+        
+        if (last_slash == p->current_path)
+            strcpy(p->current_path, "/");
+        else if (last_slash != NULL)
+            *last_slash = '\0';
+        
+        if (p->archive_prefix[0] == '\0') {
+            // Ra khỏi archive, trở về thư mục chứa nó
+            release_archive(p->archive);
+            p->archive = NULL;
+        } else {
+            // Lên một cấp bên trong archive
+            size_t len = strlen(p->archive_prefix);
+            p->archive_prefix[len - 1] = '\0';
+            char *slash = strrchr(p->archive_prefix, '/');
+            if (slash != NULL)
+                slash[1] = '\0';
+            else
+                p->archive_prefix[0] = '\0';
+        }
+        
+        p->selected_idx = 0;
+        p->start_idx = 0;
+        read_directory(p);
+        select_file(p, previous);
+        return;
+    } else if (is_dir) {
+        size_t len = strlen(p->archive_prefix);
+        snprintf(p->archive_prefix + len, sizeof(p->archive_prefix) - len, "%s/", name);
+        len = strlen(p->current_path);
+        snprintf(p->current_path + len, sizeof(p->current_path) - len, "/%s", name);
+    } else {
+        return;
+    }
+    
+    p->selected_idx = 0;
+    p->start_idx = 0;
+    read_directory(p);
+}
+
+void display_panel(FilePanel *p) {
+    int i;
+    int height, width;
+    struct tm *timeinfo;
+    char date_str[20];
+    
+    // Quick view bật: panel không hoạt động hiển thị entry đang chọn của panel kia
+    if (quick_view && !p->active) {
+        display_quick_view(p, p == all_panels[0] ? all_panels[1] : all_panels[0]);
+        return;
+    }
+    
+    werase(p->win);
+    wbkgd(p->win, COLOR_PAIR(p->active ? 2 : 1));
+    box(p->win, 0, 0);
+    
+    getmaxyx(p->win, height, width);
+    
+    // Header cho danh sách file
+    mvwprintw(p->win, 1, 2, "Name");
+    mvwprintw(p->win, 1, width - 32, "Size");
+    mvwprintw(p->win, 1, width - 16, "Modify time");
+    
+    // Hiển thị file
+    int display_count = height - 3; // Để trừ header và border
+    
+    pthread_mutex_lock(&p->lock);
+    
+    // Đảm bảo start_idx không vượt quá giới hạn
+    if (p->file_count > display_count) {
+        if (p->start_idx > p->file_count - display_count)
+            p->start_idx = p->file_count - display_count;
+    } else {
+        p->start_idx = 0;
+    }
+    
+    // Đảm bảo selected_idx luôn nằm trong vùng hiển thị
+    if (p->selected_idx < p->start_idx)
+        p->start_idx = p->selected_idx;
+    if (p->selected_idx >= p->start_idx + display_count)
+        p->start_idx = p->selected_idx - display_count + 1;
+    
+    for (i = 0; i < display_count && i + p->start_idx < p->file_count; i++) {
+        FileItem *file = &p->files[i + p->start_idx];
+        date_str[0] = '\0';
+        if (file->has_stat) {
+            timeinfo = localtime(&file->mtime);
+            strftime(date_str, 20, "%b %d %H:%M", timeinfo);
+        }
+        
+        // Highlight file được chọn
+        if (i + p->start_idx == p->selected_idx)
+            wattron(p->win, A_REVERSE);
+            
+        // Với thư mục, sử dụng màu đặc biệt
+        if (file->is_dir)
+            wattron(p->win, COLOR_PAIR(5));
+            
+        mvwprintw(p->win, i + 2, 2, "%-15s", file->name);
+        
+        if (strcmp(file->name, "..") == 0)
+            mvwprintw(p->win, i + 2, width - 32, "UP--DIR");
+        else if (file->kind != ENTRY_FILE)
+            mvwprintw(p->win, i + 2, width - 32, "%s", file->kind == ENTRY_SYMLINK ? "SYMLINK" :
+                      file->kind == ENTRY_HARDLINK ? "HARDLNK" : "SPECIAL");
+        else if (file->has_stat)
+            mvwprintw(p->win, i + 2, width - 32, "%4ldK", file->size / 1024);
+            
+        mvwprintw(p->win, i + 2, width - 16, "%s", date_str);
+        
+        if (file->is_dir)
+            wattroff(p->win, COLOR_PAIR(5));
+            
+        if (i + p->start_idx == p->selected_idx)
+            wattroff(p->win, A_REVERSE);
+    }
+    
+    // Khi đang liệt kê listing ảo, thanh cuộn dựa trên số entry ước lượng
+    long total = p->file_count;
+    if (p->enumerating && p->est_count > total)
+        total = p->est_count;
+    
+    // Vẽ thanh cuộn nếu cần
+    if (total > display_count) {
+        int scrollbar_height = height - 2;
+        
+        // Tính toán vị trí thanh cuộn
+        double ratio = (double)p->start_idx / (total - display_count);
+        int scrollbar_pos = 1 + (int)(ratio * (scrollbar_height - 1));
+        
+        // Tính toán kích thước thanh cuộn
+        int scrollbar_size = (display_count * scrollbar_height) / total;
+        if (scrollbar_size < 1) scrollbar_size = 1;
+        if (scrollbar_pos + scrollbar_size > scrollbar_height)
+            scrollbar_size = scrollbar_height - scrollbar_pos + 1;
+        
+        // Vẽ đường dẫn thanh cuộn
+        for (i = 1; i <= scrollbar_height; i++) {
+            mvwaddch(p->win, i, width - 1, ACS_VLINE);
+        }
+        
+        // Vẽ thanh cuộn
+        wattron(p->win, A_REVERSE);
+        for (i = 0; i < scrollbar_size && scrollbar_pos + i <= scrollbar_height; i++) {
+            mvwaddch(p->win, scrollbar_pos + i, width - 1, ' ');
+        }
+        wattroff(p->win, A_REVERSE);
+    }
+    
+    // Hiển thị đường dẫn hiện tại ở dưới panel
+    mvwprintw(p->win, height - 1, 2, "%s", p->current_path);
+    if (p->enumerating)
+        wprintw(p->win, " [%d/~%ld]", p->file_count - 1, total - 1);
+    else if (p->archive_indexing)
+        wprintw(p->win, " [indexing %d]", p->file_count - 1);
+    else if (p->snapshot_state == SNAPSHOT_CHECKING)
+        wprintw(p->win, " [cached]");
+    
+    // Báo worker vùng hiển thị mới để ưu tiên stat
+    p->view_rows = display_count;
+    if (p->worker_running)
+        pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    
+    // Chỉ cập nhật màn hình ảo, render() sẽ doupdate() một lần cho cả khung hình
+    wnoutrefresh(p->win);
+}
+
+
+
+void display_bottom_menu() {
+    int max_y, max_x;
+    getmaxyx(stdscr, max_y, max_x);
+    
+    // Vẽ thanh trạng thái và menu
+    attron(COLOR_PAIR(4));
+    mvhline(max_y - 2, 0, ' ', max_x);
+    mvhline(max_y - 1, 0, ' ', max_x);
+    
+    mvprintw(max_y - 1, 1, "F1 Help");
+    mvprintw(max_y - 1, 10, "F2 Menu");
+    mvprintw(max_y - 1, 19, "F3 View");
+    mvprintw(max_y - 1, 28, "F4 Edit");
+    mvprintw(max_y - 1, 37, "F5 Copy");
+    mvprintw(max_y - 1, 46, "F6 Move");
+    mvprintw(max_y - 1, 55, "F7 Mkdir");
+    mvprintw(max_y - 1, 65, "F8 Delete");
+    mvprintw(max_y - 1, 76, "F9 Quit");
+    
+    attroff(COLOR_PAIR(4));
+    wnoutrefresh(stdscr);
+}
+// Hàm hiển thị hộp thoại tạo thư mục
+WINDOW *create_dialog_window(int height, int width, int y, int x, const char *title) {
+    WINDOW *win = newwin(height, width, y, x);
+    wbkgd(win, COLOR_PAIR(3));
+    box(win, 0, 0);
+    mvwprintw(win, 0, (width - strlen(title)) / 2, "%s", title);
+    wrefresh(win);
+    return win;
+}
+
+void handle_mkdir(FilePanel *p) {
+    // Archive chỉ đọc
+    if (p->archive != NULL)
+        return;
+    
+    int max_y, max_x;
+    getmaxyx(stdscr, max_y, max_x);
+    
+    // Kích thước và vị trí của hộp thoại
+    int dialog_height = 10;
+    int dialog_width = 50;
+    int dialog_y = (max_y - dialog_height) / 2;
+    int dialog_x = (max_x - dialog_width) / 2;
+    
+    // Tạo hộp thoại
+    WINDOW *dialog = newwin(dialog_height, dialog_width, dialog_y, dialog_x);
+    wbkgd(dialog, COLOR_PAIR(3));  // Màu nền xanh nhạt
+    box(dialog, 0, 0);
+    
+    // Tiêu đề hộp thoại
+    mvwprintw(dialog, 0, (dialog_width - 17) / 2, " Make directory");
+    
+    // Hiển thị nhãn
+    mvwprintw(dialog, 3, 3, "Nhập tên thư mục:");
+    
+    // Tạo ô nhập liệu
+    WINDOW *input_win = newwin(1, 34, dialog_y + 5, dialog_x + 8);
+    wbkgd(input_win, COLOR_PAIR(2));  // Màu khác để nổi bật
+    box(input_win, 0, 0);
+    
+    // Tạo nút OK
+    WINDOW *ok_button = newwin(3, 10, dialog_y + dialog_height - 4, dialog_x + 10);
+    wbkgd(ok_button, COLOR_PAIR(4));  // Màu nút bình thường
+    box(ok_button, 0, 0);
+    mvwprintw(ok_button, 1, 3, "Ok");
+    
+    // Tạo nút Cancel
+    WINDOW *cancel_button = newwin(3, 10, dialog_y + dialog_height - 4, dialog_x + 30);
+    wbkgd(cancel_button, COLOR_PAIR(4));  // Màu nút bình thường
+    box(cancel_button, 0, 0);
+    mvwprintw(cancel_button, 1, 2, "Cancel");
+    
+    // Hiển thị dialog và các nút
+    wrefresh(dialog);
+    wrefresh(input_win);
+    wrefresh(ok_button);
+    wrefresh(cancel_button);
+    
+    // Chuẩn bị cho việc nhập liệu
+    char dirname[256] = {0};
+    int pos = 0;
+    int ch;
+    int max_input = 32;
+    
+    // Trạng thái focus: 0 = nhập liệu, 1 = nút OK, 2 = nút Cancel
+    int focus_state = 0;
+    
+    // Khởi tạo focus ban đầu tại ô nhập liệu
+    curs_set(1);  // Hiện con trỏ
+    keypad(input_win, TRUE);
+    keypad(dialog, TRUE);
+    wmove(input_win, 0, 0);
+    wrefresh(input_win);
+    
+    // Vòng lặp xử lý nhập liệu và điều hướng
+    while (1) {
+        if (focus_state == 0) {
+            // Đang ở chế độ nhập liệu
+            wmove(input_win, 0, pos);
+            wrefresh(input_win);
+            ch = wgetch(input_win);
+            
+            if (ch == '\n') {
+                // Enter tại ô nhập liệu = OK
+                if (strlen(dirname) > 0) {
+                    // Tạo thư mục
+                    char new_dir_path[MAX_PATH];
+                    snprintf(new_dir_path, MAX_PATH, "%s/%s", p->current_path, dirname);
+                    
+                    if (mkdir(new_dir_path, 0755) == 0) {
+                        read_directory(p);
+                        break;
+                    } else {
+                        mvwprintw(dialog, dialog_height - 2, 2, "Error: Can not create directory!");
+                        wrefresh(dialog);
+                        napms(1500);
+                    }
+                }
+            } else if (ch == KEY_DOWN) {
+                // Chuyển xuống nút OK
+                focus_state = 1;
+                curs_set(0);  // Ẩn con trỏ
+                
+                // Tô vàng nút OK
+                wbkgd(ok_button, COLOR_PAIR(5));  // Màu vàng cho nút được chọn
+                wrefresh(ok_button);
+            } else if (ch == KEY_BACKSPACE || ch == 127) {
+                if (pos > 0) {
+                    // Xóa ký tự
+                    pos--;
+                    dirname[pos] = '\0';
+                    mvwaddch(input_win, 0, pos, ' ');
+                    wmove(input_win, 0, pos);
+                    wrefresh(input_win);
+                }
+            } else if (ch == 27) {  // ESC
+                // Hủy và thoát
+                break;
+            } else if (pos < max_input && ch >= 32 && ch <= 126) {
+                // Nhập ký tự bình thường
+                dirname[pos++] = ch;
+                dirname[pos] = '\0';
+                waddch(input_win, ch);
+                wrefresh(input_win);
+            }
+        } else if (focus_state == 1) {
+            // Đang ở nút OK
+            ch = wgetch(dialog);
+            
+            if (ch == '\n') {
+                // Enter tại nút OK
+                if (strlen(dirname) > 0) {
+                    // Tạo thư mục
+                    char new_dir_path[MAX_PATH];
+                    snprintf(new_dir_path, MAX_PATH, "%s/%s", p->current_path, dirname);
+                    
+                    if (mkdir(new_dir_path, 0755) == 0) {
+                        read_directory(p);
+                        break;
+                    } else {
+                        mvwprintw(dialog, dialog_height - 2, 2, "Lỗi: Không thể tạo thư mục!");
+                        wrefresh(dialog);
+                        napms(1500);
+                    }
+                }
+            } else if (ch == KEY_UP) {
+                // Chuyển lên ô nhập liệu
+                focus_state = 0;
+                curs_set(1);  // Hiển thị con trỏ nhập liệu
+                
+                // Bỏ tô vàng nút OK
+                wbkgd(ok_button, COLOR_PAIR(4));  // Màu mặc định cho nút
+                wrefresh(ok_button);
+                
+                // Focus lại ô nhập liệu
+                wmove(input_win, 0, pos);
+                wrefresh(input_win);
+            } else if (ch == KEY_RIGHT) {
+                // Chuyển sang nút Cancel
+                focus_state = 2;
+                
+                // Đổi màu các nút
+                wbkgd(ok_button, COLOR_PAIR(4));  // Màu mặc định
+                wbkgd(cancel_button, COLOR_PAIR(5));  // Màu vàng
+                wrefresh(ok_button);
+                wrefresh(cancel_button);
+            } else if (ch == 27) {  // ESC
+                // Hủy và thoát
+                break;
+            }
+        } else if (focus_state == 2) {
+            // Đang ở nút Cancel
+            ch = wgetch(dialog);
+            
+            if (ch == '\n' || ch == 27) {
+                // Enter hoặc ESC tại nút Cancel = thoát
+                break;
+            } else if (ch == KEY_UP) {
+                // Chuyển lên ô nhập liệu
+                focus_state = 0;
+                curs_set(1);  // Hiển thị con trỏ nhập liệu
+                
+                // Bỏ tô vàng nút Cancel
+                wbkgd(cancel_button, COLOR_PAIR(4));  // Màu mặc định cho nút
+                wrefresh(cancel_button);
+                
+                // Focus lại ô nhập liệu
+                wmove(input_win, 0, pos);
+                wrefresh(input_win);
+            } else if (ch == KEY_LEFT) {
+                // Chuyển sang nút OK
+                focus_state = 1;
+                
+                // Đổi màu các nút
+                wbkgd(cancel_button, COLOR_PAIR(4));  // Màu mặc định
+                wbkgd(ok_button, COLOR_PAIR(5));  // Màu vàng
+                wrefresh(cancel_button);
+                wrefresh(ok_button);
+            }
+        }
+    }
+    
+    // Dọn dẹp
+    curs_set(0);  // Ẩn con trỏ
+    delwin(input_win);
+    delwin(ok_button);
+    delwin(cancel_button);
+    delwin(dialog);
+    touchwin(stdscr);
+    refresh();
+    
+    // Vẽ lại panel
+    display_panel(p);
+}
+void handle_delete(FilePanel *p) {
+    char selected_name[256];
+    int is_dir;
+    
+    // Archive chỉ đọc
+    if (p->archive != NULL)
+        return;
+    
+    // Chép entry ra ngoài vì worker của listing ảo có thể cấp phát lại mảng files
+    pthread_mutex_lock(&p->lock);
+    if (p->selected_idx < 0 || p->selected_idx >= p->file_count ||
+        strcmp(p->files[p->selected_idx].name, "..") == 0) {  // Bỏ qua trường hợp ".."
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    ensure_stat(p, p->selected_idx);
+    snprintf(selected_name, sizeof(selected_name), "%s", p->files[p->selected_idx].name);
+    is_dir = p->files[p->selected_idx].is_dir;
+    pthread_mutex_unlock(&p->lock);
+    
+    // Lấy kích thước màn hình
+    int max_y, max_x;
+    getmaxyx(stdscr, max_y, max_x);
+    
+    // Kích thước và vị trí hộp thoại
+    int dialog_height = 6;
+    int dialog_width = 40;
+    int dialog_y = (max_y - dialog_height) / 2;
+    int dialog_x = (max_x - dialog_width) / 2;
+    
+    // Tạo hộp thoại màu đỏ
+    WINDOW *dialog = newwin(dialog_height, dialog_width, dialog_y, dialog_x);
+    wbkgd(dialog, COLOR_PAIR(7));  // Màu nền đỏ
+    box(dialog, 0, 0);
+    
+    // Tiêu đề hộp thoại
+    mvwprintw(dialog, 0, (dialog_width - 6) / 2, " Delete ");
+    
+    // Thông báo xác nhận xóa
+    char message[256];
+    if (is_dir) {
+        snprintf(message, sizeof(message), "Delete directory \"%s\"?", selected_name);
+    } else {
+        snprintf(message, sizeof(message), "Delete file \"%s\"?", selected_name);
+    }
+    mvwprintw(dialog, 2, (dialog_width - strlen(message)) / 2, "%s", message);
+    
+    // Tạo nút Yes
+    WINDOW *yes_button = newwin(1, 7, dialog_y + 4, dialog_x + 10);
+    wbkgd(yes_button, COLOR_PAIR(7));  // Màu nền đỏ
+    
+    // Tạo nút No
+    WINDOW *no_button = newwin(1, 6, dialog_y + 4, dialog_x + 24);
+    wbkgd(no_button, COLOR_PAIR(7));  // Màu nền đỏ
+    
+    // Trạng thái focus: 0 = Yes, 1 = No
+    int focus_state = 1;  // Mặc định focus vào No (an toàn hơn)
+    
+    // Hiển thị nút với focus ban đầu
+    wattron(yes_button, A_REVERSE);
+    wattron(no_button, A_REVERSE);
+    
+    if (focus_state == 0) {
+        wattroff(no_button, A_REVERSE);
+    } else {
+        wattroff(yes_button, A_REVERSE);
+    }
+    
+    // Vẽ nội dung nút
+    mvwprintw(yes_button, 0, 1, " Yes ");
+    mvwprintw(no_button, 0, 1, " No ");
+    
+    // Hiển thị hộp thoại và các nút
+    wrefresh(dialog);
+    wrefresh(yes_button);
+    wrefresh(no_button);
+    
+    // Xử lý phím
+    keypad(dialog, TRUE);
+    int ch;
+    
+    while (1) {
+        ch = wgetch(dialog);
+        
+        if (ch == KEY_LEFT || ch == KEY_RIGHT) {
+            // Chuyển đổi focus giữa hai nút
+            focus_state = !focus_state;
+            
+            // Cập nhật hiển thị nút
+            if (focus_state == 0) {
+                wattron(yes_button, A_REVERSE);
+                wattroff(no_button, A_REVERSE);
+            } else {
+                wattroff(yes_button, A_REVERSE);
+                wattron(no_button, A_REVERSE);
+            }
+            
+            // Vẽ lại nội dung nút
+            mvwprintw(yes_button, 0, 1, " Yes ");
+            mvwprintw(no_button, 0, 1, " No ");
+            
+            wrefresh(yes_button);
+            wrefresh(no_button);
+        } else if (ch == '\n') {
+            // Enter = xác nhận lựa chọn hiện tại
+            if (focus_state == 0) {  // Chọn Yes
+                // Xóa thư mục hoặc file
+                char path[MAX_PATH];
+                snprintf(path, MAX_PATH, "%s/%s", p->current_path, selected_name);
+                
+                int delete_success = 0;
+                if (is_dir) {
+                    delete_success = rmdir(path) == 0;
+                } else {
+                    delete_success = unlink(path) == 0;
+                }
+                
+                if (!delete_success) {
+                    // Hiển thị thông báo lỗi
+                    if (is_dir) {
+                        mvwprintw(dialog, 4, 5, "Error: Directory not empty!");
+                    } else {
+                        mvwprintw(dialog, 4, 8, "Error: Cannot delete file!");
+                    }
+                    wrefresh(dialog);
+                    napms(1500);
+                } else {
+                    // Cập nhật lại danh sách file
+                    read_directory(p);
+                }
+                break;
+            } else {  // Chọn No
+                break;
+            }
+        } else if (ch == 27) {  // ESC = Cancel
+            break;
+        }
+    }
+    
+    // Dọn dẹp
+    delwin(yes_button);
+    delwin(no_button);
+    delwin(dialog);
+    touchwin(stdscr);
+    refresh();
+    
+    // Vẽ lại panel
+    display_panel(p);
+}
+
+
+// Đọc luồng tar.gz đã giải nén từ vị trí bất kỳ nhờ checkpoint của index
+typedef struct {
+    Archive *a;
+    int fd;
+    z_stream strm;
+    int ready;
+    int raw;             // Đang giải nén deflate thô (bắt đầu từ checkpoint)
+    int trailer_skip;    // Số byte trailer gzip còn phải bỏ qua trước member kế tiếp
+    int eof;
+    off_t out_pos;       // Vị trí hiện tại trong luồng đã giải nén
+    unsigned char in[GZ_CHUNK];
+} GzReader;
+
+int gz_restart(GzReader *r, off_t target) {
+    GzPoint *pt = malloc(sizeof(GzPoint));
+    if (pt == NULL)
+        return -1;
+    
+    // Checkpoint cuối cùng không vượt quá target
+    pthread_mutex_lock(&r->a->lock);
+    int lo = 0, hi = r->a->point_count - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (r->a->points[mid].out <= target) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found >= 0)
+        memcpy(pt, &r->a->points[found], sizeof(GzPoint));
+    pthread_mutex_unlock(&r->a->lock);
+    
+    if (found < 0 || inflateReset2(&r->strm, -15) != Z_OK ||
+        lseek(r->fd, pt->in - (pt->bits ? 1 : 0), SEEK_SET) < 0) {
+        free(pt);
+        return -1;
+    }
+    r->strm.avail_in = 0;
+    
+    if (pt->bits) {
+        unsigned char c;
+        if (read(r->fd, &c, 1) != 1) {
+            free(pt);
+            return -1;
+        }
+        inflatePrime(&r->strm, pt->bits, c >> (8 - pt->bits));
+    }
+    inflateSetDictionary(&r->strm, pt->window, GZ_WINSIZE);
+    
+    r->out_pos = pt->out;
+    r->raw = 1;
+    r->trailer_skip = 0;
+    r->eof = 0;
+    r->ready = 1;
+    free(pt);
+    return 0;
+}
+
+ssize_t gz_read(GzReader *r, unsigned char *buf, size_t len) {
+    r->strm.next_out = buf;
+    r->strm.avail_out = len;
+    
+    while (r->strm.avail_out > 0 && !r->eof) {
+        if (r->strm.avail_in == 0) {
+            ssize_t n = read(r->fd, r->in, GZ_CHUNK);
+            if (n < 0)
+                return -1;
+            if (n == 0) {
+                r->eof = 1;
+                break;
+            }
+            r->strm.next_in = r->in;
+            r->strm.avail_in = n;
+        }
+        
+        if (r->trailer_skip > 0) {
+            unsigned k = r->strm.avail_in < (unsigned)r->trailer_skip ? r->strm.avail_in : (unsigned)r->trailer_skip;
+            r->strm.next_in += k;
+            r->strm.avail_in -= k;
+            r->trailer_skip -= k;
+            if (r->trailer_skip == 0) {
+                inflateReset2(&r->strm, 31);
+                r->raw = 0;
+            }
+            continue;
+        }
+        
+        int ret = inflate(&r->strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            // Hết một member gzip: deflate thô không tự đọc trailer 8 byte
+            if (r->raw)
+                r->trailer_skip = 8;
+            else
+                inflateReset(&r->strm);
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return -1;
+        }
+    }
+    
+    size_t got = len - r->strm.avail_out;
+    r->out_pos += got;
+    return got;
+}
+
+// Tới vị target: đọc tiếp nếu gần, ngược lại nhảy tới checkpoint gần nhất
+int gz_seek(GzReader *r, off_t target) {
+    unsigned char skip[GZ_CHUNK];
+    
+    if (!r->ready || target < r->out_pos || target - r->out_pos > GZ_SPAN) {
+        if (gz_restart(r, target) != 0)
+            return -1;
+    }
+    while (r->out_pos < target) {
+        size_t want = target - r->out_pos < (off_t)sizeof(skip) ? (size_t)(target - r->out_pos) : sizeof(skip);
+        if (gz_read(r, skip, want) <= 0)
+            return -1;
+    }
+    return 0;
+}
+
+int write_all(int fd, const unsigned char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Giải nén một member ra fd đích theo kiểu luồng, không giữ cả member trong bộ nhớ
+int extract_member(Archive *a, const ArchiveMember *m, int out, GzReader *gz, int tar_fd) {
+    unsigned char buf[GZ_CHUNK];
+    off_t left = m->size;
+    
+    if (a->type == ARCHIVE_TAR) {
+        off_t pos = m->offset;
+        while (left > 0) {
+            ssize_t n = pread(tar_fd, buf, left < (off_t)sizeof(buf) ? (size_t)left : sizeof(buf), pos);
+            if (n <= 0 || write_all(out, buf, n) != 0)
+                return -1;
+            pos += n;
+            left -= n;
+        }
+        return 0;
+    }
+    
+    if (a->type == ARCHIVE_TGZ) {
+        if (gz_seek(gz, m->offset) != 0)
+            return -1;
+        while (left > 0) {
+            ssize_t n = gz_read(gz, buf, left < (off_t)sizeof(buf) ? (size_t)left : sizeof(buf));
+            if (n <= 0 || write_all(out, buf, n) != 0)
+                return -1;
+            left -= n;
+        }
+        return 0;
+    }
+    
+    // zip: dữ liệu nằm sau local header
+    if ((uint64_t)m->offset + 30 > a->map_size || rd32(a->map + m->offset) != 0x04034b50)
+        return -1;
+    const unsigned char *data = a->map + m->offset + 30 + rd16(a->map + m->offset + 26) +
+                                rd16(a->map + m->offset + 28);
+    if (data + m->comp_size > a->map + a->map_size)
+        return -1;
+    
+    if (m->method == 0)
+        return write_all(out, data, m->size);
+    if (m->method != 8)
+        return -1;
+    
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, -15) != Z_OK)
+        return -1;
+    
+    off_t in_left = m->comp_size;
+    int ret = Z_OK;
+    strm.next_in = (unsigned char *)data;
+    while (ret != Z_STREAM_END) {
+        if (strm.avail_in == 0) {
+            if (in_left == 0)
+                break;
+            strm.avail_in = in_left < (1 << 30) ? in_left : (1 << 30);
+            in_left -= strm.avail_in;
+        }
+        strm.next_out = buf;
+        strm.avail_out = sizeof(buf);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        if ((ret != Z_OK && ret != Z_STREAM_END) ||
+            write_all(out, buf, sizeof(buf) - strm.avail_out) != 0) {
+            inflateEnd(&strm);
+            return -1;
+        }
+    }
+    inflateEnd(&strm);
+    return ret == Z_STREAM_END ? 0 : -1;
+}
+
+// Không cho member thoát ra ngoài thư mục đích bằng ".."
+int path_is_safe(const char *rel) {
+    const char *c = rel;
+    while (*c != '\0') {
+        while (*c == '/')
+            c++;
+        const char *end = strchr(c, '/');
+        size_t len = end ? (size_t)(end - c) : strlen(c);
+        if (len == 2 && c[0] == '.' && c[1] == '.')
+            return 0;
+        c += len;
+    }
+    return 1;
+}
+
+int make_dirs(const char *path) {
+    char tmp[MAX_PATH];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+    for (char *c = tmp + 1; *c != '\0'; c++) {
+        if (*c == '/') {
+            *c = '\0';
+            if (mkdir(tmp, 0755) != 0 && errno != EEXIST)
+                return -1;
+            *c = '/';
+        }
+    }
+    return mkdir(tmp, 0755) != 0 && errno != EEXIST ? -1 : 0;
+}
+
+// Tìm member file thường theo đường dẫn trong archive (đích của hardlink)
+int find_member(Archive *a, const char *path, ArchiveMember *out) {
+    int found = -1;
+    
+    while (path[0] == '/' || (path[0] == '.' && path[1] == '/'))
+        path += path[0] == '/' ? 1 : 2;
+    pthread_mutex_lock(&a->lock);
+    for (int i = 0; i < a->member_count; i++) {
+        if (!a->members[i].is_dir && a->members[i].kind == ENTRY_FILE &&
+            strcmp(a->members[i].path, path) == 0) {
+            *out = a->members[i];
+            found = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&a->lock);
+    return found;
+}
+
+// Đích của symlink: tar lưu trong header, zip lưu trong dữ liệu của member
+int read_link_target(Archive *a, const ArchiveMember *m, char *target, size_t size, GzReader *gz, int tar_fd) {
+    if (m->link != NULL) {
+        snprintf(target, size, "%s", m->link);
+        return target[0] != '\0' ? 0 : -1;
+    }
+    if (m->size <= 0 || (size_t)m->size >= size)
+        return -1;
+    
+    int fd = memfd_create("link", MFD_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    int ok = extract_member(a, m, fd, gz, tar_fd) == 0 && pread(fd, target, m->size, 0) == m->size;
+    close(fd);
+    target[ok ? m->size : 0] = '\0';
+    return ok ? 0 : -1;
+}
+
+// F5 trong archive: giải nén entry đang chọn (cả thư mục con) vào thư mục của panel kia
+void handle_extract(FilePanel *p, FilePanel *dst) {
+    Archive *a = p->archive;
+    char name[256];
+    char member_path[MAX_PATH];
+    
+    if (dst->archive != NULL || p->selected_idx <= 0 || p->selected_idx >= p->file_count)
+        return;
+    snprintf(name, sizeof(name), "%s", p->files[p->selected_idx].name);
+    snprintf(member_path, sizeof(member_path), "%s%s", p->archive_prefix, name);
+    size_t member_len = strlen(member_path);
+    
+    int max_y, max_x;
+    getmaxyx(stdscr, max_y, max_x);
+    int dialog_height = 6;
+    int dialog_width = 50;
+    WINDOW *dialog = create_dialog_window(dialog_height, dialog_width, (max_y - dialog_height) / 2,
+                                          (max_x - dialog_width) / 2, " Extract ");
+    mvwprintw(dialog, 2, 2, "%.*s", dialog_width - 4, name);
+    mvwprintw(dialog, 3, 2, "-> %.*s", dialog_width - 7, dst->current_path);
+    wrefresh(dialog);
+    
+    // Chép danh sách member cần giải nén ra ngoài vì index có thể đang lớn thêm
+    pthread_mutex_lock(&a->lock);
+    int count = 0;
+    ArchiveMember *todo = malloc((a->member_count + 1) * sizeof(ArchiveMember));
+    for (int i = 0; todo != NULL && i < a->member_count; i++) {
+        const char *path = a->members[i].path;
+        if (strncmp(path, member_path, member_len) == 0 &&
+            (path[member_len] == '\0' || path[member_len] == '/'))
+            todo[count++] = a->members[i];
+    }
+    pthread_mutex_unlock(&a->lock);
+    
+    GzReader *gz = NULL;
+    int tar_fd = -1;
+    if (a->type == ARCHIVE_TGZ && (gz = calloc(1, sizeof(GzReader))) != NULL) {
+        gz->a = a;
+        gz->fd = open(a->path, O_RDONLY | O_CLOEXEC);
+        inflateInit2(&gz->strm, -15);
+    } else if (a->type == ARCHIVE_TAR) {
+        tar_fd = open(a->path, O_RDONLY | O_CLOEXEC);
+    }
+    
+    char base[MAX_PATH];
+    if (dst->current_path[strlen(dst->current_path) - 1] == '/')
+        snprintf(base, sizeof(base), "%s%s", dst->current_path, name);
+    else
+        snprintf(base, sizeof(base), "%s/%s", dst->current_path, name);
+    
+    int errors = todo == NULL;
+    for (int i = 0; i < count; i++) {
+        const char *rel = todo[i].path + member_len;
+        char out_path[MAX_PATH];
+        
+        if (!path_is_safe(todo[i].path)) {
+            errors++;
+            continue;
+        }
+        snprintf(out_path, sizeof(out_path), "%s%s", base, rel);
+        
+        if (todo[i].is_dir) {
+            if (make_dirs(out_path) != 0)
+                errors++;
+            continue;
+        }
+        
+        // Thiết bị/FIFO không được tạo; symlink được tạo sau cùng
+        if (todo[i].kind == ENTRY_SPECIAL) {
+            errors++;
+            continue;
+        }
+        if (todo[i].kind == ENTRY_SYMLINK)
+            continue;
+        
+        // Hardlink: chép nội dung của member đích thay vì tạo link
+        ArchiveMember data = todo[i];
+        if (todo[i].kind == ENTRY_HARDLINK &&
+            (todo[i].link == NULL || find_member(a, todo[i].link, &data) != 0)) {
+            errors++;
+            continue;
+        }
+        
+        char *slash = strrchr(out_path, '/');
+        if (slash != NULL && slash != out_path) {
+            *slash = '\0';
+            make_dirs(out_path);
+            *slash = '/';
+        }
+        
+        // Như F5 ngoài archive: không ghi đè hay ghi xuyên symlink đã có ở đích, tính là lỗi
+        int out = open(out_path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+        if (out < 0 || extract_member(a, &data, out, gz, tar_fd) != 0)
+            errors++;
+        if (out >= 0) {
+            struct timespec times[2] = {{0, UTIME_OMIT}, {todo[i].mtime, 0}};
+            futimens(out, times);
+            close(out);
+        }
+    }
+    
+    // Tạo symlink sau khi mọi file đã được ghi, để không member nào bị ghi xuyên qua
+    // một symlink vừa giải nén ra ngoài thư mục đích
+    for (int i = 0; i < count; i++) {
+        const char *rel = todo[i].path + member_len;
+        char out_path[MAX_PATH], target[MAX_PATH];
+        
+        if (todo[i].is_dir || todo[i].kind != ENTRY_SYMLINK || !path_is_safe(todo[i].path))
+            continue;
+        snprintf(out_path, sizeof(out_path), "%s%s", base, rel);
+        char *slash = strrchr(out_path, '/');
+        if (slash != NULL && slash != out_path) {
+            *slash = '\0';
+            make_dirs(out_path);
+            *slash = '/';
+        }
+        if (read_link_target(a, &todo[i], target, sizeof(target), gz, tar_fd) != 0 ||
+            symlink(target, out_path) != 0)
+            errors++;
+    }
+    
+    if (gz != NULL) {
+        inflateEnd(&gz->strm);
+        if (gz->fd >= 0)
+            close(gz->fd);
+        free(gz);
+    }
+    if (tar_fd >= 0)
+        close(tar_fd);
+    free(todo);
+    
+    if (errors) {
+        mvwprintw(dialog, dialog_height - 2, 2, "Error: %d item(s) could not be extracted!", errors);
+        wrefresh(dialog);
+        napms(1500);
+    }
+    
+    delwin(dialog);
+    touchwin(stdscr);
+    refresh();
+    dst->reload_pending |= RELOAD_FORCE;
+}
+
+// Gom các file trong cây src thành lô CopyJob; thư mục và symlink được tạo ngay
+void copy_tree(const char *src, const char *dst, CopyJob *jobs, int *count, int *errors) {
+    struct stat st;
+    
+    if (lstat(src, &st) != 0) {
+        (*errors)++;
+        return;
+    }
+    
+    if (S_ISLNK(st.st_mode)) {
+        char target[MAX_PATH];
+        ssize_t n = readlink(src, target, sizeof(target) - 1);
+        if (n >= 0)
+            target[n] = '\0';
+        if (n < 0 || symlink(target, dst) != 0)
+            (*errors)++;
+        return;
+    }
+    
+    if (S_ISDIR(st.st_mode)) {
+        if (mkdir(dst, st.st_mode & 0777) != 0 && errno != EEXIST) {
+            (*errors)++;
+            return;
+        }
+        DIR *dir = opendir(src);
+        if (dir == NULL) {
+            (*errors)++;
+            return;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+            char child_src[MAX_PATH], child_dst[MAX_PATH];
+            snprintf(child_src, sizeof(child_src), "%s/%s", src, entry->d_name);
+            snprintf(child_dst, sizeof(child_dst), "%s/%s", dst, entry->d_name);
+            copy_tree(child_src, child_dst, jobs, count, errors);
+        }
+        closedir(dir);
+        return;
+    }
+    
+    // Thiết bị, fifo, socket: không chép
+    if (!S_ISREG(st.st_mode)) {
+        (*errors)++;
+        return;
+    }
+    
+    // Không ghi đè file đã có ở đích: bỏ qua sớm và tính là lỗi (O_EXCL khi mở mới là chốt chặn)
+    struct stat dst_st;
+    if (lstat(dst, &dst_st) == 0) {
+        (*errors)++;
+        return;
+    }
+    
+    CopyJob *job = &jobs[(*count)++];
+    snprintf(job->src, sizeof(job->src), "%s", src);
+    snprintf(job->dst, sizeof(job->dst), "%s", dst);
+    job->size = st.st_size;
+    job->mode = st.st_mode;
+    job->mtime = st.st_mtime;
+    job->failed = 0;
+    job->created = 0;
+    
+    if (*count == COPY_BATCH) {
+        *errors += io_copy_batch(jobs, *count);
+        *count = 0;
+    }
+}
+
+// Chép cả cây src sang dst qua backend I/O, trả về số lỗi
+int copy_path(const char *src, const char *dst) {
+    CopyJob *jobs = malloc(COPY_BATCH * sizeof(CopyJob));
+    int count = 0, errors = 0;
+    
+    if (jobs == NULL)
+        return 1;
+    copy_tree(src, dst, jobs, &count, &errors);
+    if (count > 0)
+        errors += io_copy_batch(jobs, count);
+    free(jobs);
+    return errors;
+}
+
+// F5: chép entry đang chọn (file hoặc cả thư mục) sang thư mục của panel kia
+void handle_copy(FilePanel *p, FilePanel *dst) {
+    char name[256];
+    char src_path[MAX_PATH], dst_path[MAX_PATH];
+    char real_src[MAX_PATH], real_dst[MAX_PATH], real_dir[MAX_PATH];
+    
+    if (dst->archive != NULL)
+        return;
+    
+    pthread_mutex_lock(&p->lock);
+    if (p->selected_idx <= 0 || p->selected_idx >= p->file_count) {
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    snprintf(name, sizeof(name), "%s", p->files[p->selected_idx].name);
+    pthread_mutex_unlock(&p->lock);
+    
+    if (p->current_path[strlen(p->current_path) - 1] == '/')
+        snprintf(src_path, sizeof(src_path), "%s%s", p->current_path, name);
+    else
+        snprintf(src_path, sizeof(src_path), "%s/%s", p->current_path, name);
+    if (dst->current_path[strlen(dst->current_path) - 1] == '/')
+        snprintf(dst_path, sizeof(dst_path), "%s%s", dst->current_path, name);
+    else
+        snprintf(dst_path, sizeof(dst_path), "%s/%s", dst->current_path, name);
+    
+    // Không chép đè lên chính nó hoặc vào bên trong chính nó; so đường dẫn thật
+    // để hai panel trỏ cùng thư mục qua symlink cũng bị chặn
+    if (realpath(src_path, real_src) == NULL || realpath(dst->current_path, real_dst) == NULL ||
+        realpath(p->current_path, real_dir) == NULL)
+        return;
+    size_t src_len = strlen(real_src);
+    if (strncmp(real_dst, real_src, src_len) == 0 &&
+        (real_dst[src_len] == '\0' || real_dst[src_len] == '/'))
+        return;
+    if (strcmp(real_dir, real_dst) == 0)
+        return;
+    
+    int max_y, max_x;
+    getmaxyx(stdscr, max_y, max_x);
+    int dialog_height = 6;
+    int dialog_width = 50;
+    WINDOW *dialog = create_dialog_window(dialog_height, dialog_width, (max_y - dialog_height) / 2,
+                                          (max_x - dialog_width) / 2, " Copy ");
+    mvwprintw(dialog, 2, 2, "%.*s", dialog_width - 4, name);
+    mvwprintw(dialog, 3, 2, "-> %.*s", dialog_width - 7, dst->current_path);
+    wrefresh(dialog);
+    
+    int errors = copy_path(src_path, dst_path);
+    if (errors) {
+        mvwprintw(dialog, dialog_height - 2, 2, "Error: %d item(s) could not be copied!", errors);
+        wrefresh(dialog);
+        napms(1500);
+    }
+    
+    delwin(dialog);
+    touchwin(stdscr);
+    refresh();
+    dst->reload_pending |= RELOAD_FORCE;
+}
+
+// Xoá cache trang/inode để đo cold cache (cần quyền root)
+int drop_caches() {
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    int ok = write(fd, "3", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+// Đo backend I/O, không mở giao diện:
+//   file_manager --bench-list DIR       liệt kê và stat mọi entry của DIR
+//   file_manager --bench-copy SRC DST   chép cây SRC vào DST/<backend>
+int run_benchmark(int argc, char **argv) {
+    int backends[] = {IO_BACKEND_SYNC, IO_BACKEND_POOL, IO_BACKEND_URING};
+    int have_uring = io_backend == IO_BACKEND_URING;
+    int copy = strcmp(argv[1], "--bench-copy") == 0;
+    
+    if ((copy && argc < 4) || (!copy && strcmp(argv[1], "--bench-list") != 0)) {
+        fprintf(stderr, "usage: %s --bench-list DIR | --bench-copy SRC DST\n", argv[0]);
+        return 1;
+    }
+    
+    for (int b = 0; b < 3; b++) {
+        if (backends[b] == IO_BACKEND_URING && !have_uring) {
+            printf("%-9s unavailable\n", io_backend_name(backends[b]));
+            continue;
+        }
+        io_backend = backends[b];
+        int cold = drop_caches();
+        long long start = now_ms();
+        long long stat_start = start;
+        int count = 0, errors = 0;
+        
+        if (copy) {
+            char dst[MAX_PATH];
+            snprintf(dst, sizeof(dst), "%s/%s", argv[3], io_backend_name(io_backend));
+            errors = copy_path(argv[2], dst);
+        } else {
+            FilePanel bench;
+            memset(&bench, 0, sizeof(bench));
+            DIR *dir = opendir(argv[2]);
+            if (dir == NULL) {
+                perror(argv[2]);
+                return 1;
+            }
+            struct dirent *entry;
+            while ((entry = readdir(dir)) != NULL) {
+                if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                    append_file(&bench, entry->d_name);
+            }
+            stat_start = now_ms();
+            io_stat_batch(dirfd(dir), bench.files, bench.file_count);
+            count = bench.file_count;
+            closedir(dir);
+            clear_files(&bench);
+            free(bench.files);
+        }
+        
+        printf("%-9s %6lld ms  %s", io_backend_name(io_backend), now_ms() - start,
+               cold ? "cold cache" : "warm cache");
+        if (copy)
+            printf("  errors %d\n", errors);
+        else
+            printf("  %d entries (stat %lld ms)\n", count, now_ms() - stat_start);
+    }
+    return 0;
+}
+
+// ---- Xem nhanh (quick view) ----
+// Panel không hoạt động hiển thị nội dung entry dưới con trỏ của panel kia.
+// Luồng chính chỉ ghi request mới nhất vào một ô duy nhất (không có hàng đợi);
+// luồng nền đọc với giới hạn byte/thời gian và bỏ dở ngay khi request đổi.
+
+typedef struct {
+    dev_t dev;           // (dev, ino, mtime) là khoá cache
+    ino_t ino;
+    time_t mtime;
+    int is_dir;
+    off_t size;          // File: kích thước; thư mục: tổng kích thước các file con
+    long children;       // Số entry con của thư mục
+    int partial;         // Hết ngân sách trước khi đọc xong thư mục
+    char type[48];
+    unsigned char *text; // Các dòng đầu của file văn bản (NULL nếu không phải văn bản)
+    size_t text_len;
+    unsigned long used;  // Lần dùng gần nhất, cho LRU
+} Preview;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int running;
+    int stop;
+    char path[MAX_PATH];      // Request mới nhất
+    time_t mtime;
+    volatile unsigned gen;    // Tăng mỗi khi request đổi; luồng nền so sánh để huỷ việc cũ
+    int shown;                // Ô cache của kết quả cho shown_gen (-1 nếu lỗi)
+    unsigned shown_gen;
+    char error[64];
+    Preview cache[PREVIEW_CACHE_MAX];
+    int cache_count;
+    unsigned long tick;
+} PreviewState;
+
+PreviewState preview = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER};
+
+// Chữ ký nhận dạng kiểu file theo byte đầu
+static const struct {
+    int offset;
+    int len;
+    const char *magic;
+    const char *type;
+} magic_table[] = {
+    {0, 4, "\x7f" "ELF", "ELF executable"},
+    {0, 8, "\x89PNG\r\n\x1a\n", "PNG image"},
+    {0, 3, "\xff\xd8\xff", "JPEG image"},
+    {0, 6, "GIF87a", "GIF image"},
+    {0, 6, "GIF89a", "GIF image"},
+    {0, 5, "%PDF-", "PDF document"},
+    {0, 4, "PK\x03\x04", "Zip archive"},
+    {0, 2, "\x1f\x8b", "gzip compressed data"},
+    {0, 3, "BZh", "bzip2 compressed data"},
+    {0, 6, "\xfd" "7zXZ\0", "XZ compressed data"},
+    {0, 4, "\x28\xb5\x2f\xfd", "Zstandard compressed data"},
+    {0, 6, "7z\xbc\xaf\x27\x1c", "7-zip archive"},
+    {257, 5, "ustar", "tar archive"},
+    {0, 16, "SQLite format 3\0", "SQLite database"},
+    {0, 4, "RIFF", "RIFF data (WAV/AVI/WebP)"},
+    {0, 4, "OggS", "Ogg media"},
+    {0, 3, "ID3", "MP3 audio"},
+    {4, 4, "ftyp", "MP4/QuickTime media"},
+    {0, 4, "\x1a\x45\xdf\xa3", "Matroska/WebM media"},
+    {0, 4, "\xca\xfe\xba\xbe", "Java class / Mach-O universal"},
+    {0, 2, "MZ", "DOS/Windows executable"},
+    {0, 2, "#!", "script"},
+};
+
+// Đoán kiểu từ byte đầu; trả về 1 nếu là văn bản
+int sniff_type(const unsigned char *buf, size_t len, char *type, size_t type_size) {
+    if (len == 0) {
+        snprintf(type, type_size, "empty");
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(magic_table) / sizeof(magic_table[0]); i++) {
+        if ((size_t)(magic_table[i].offset + magic_table[i].len) <= len &&
+            memcmp(buf + magic_table[i].offset, magic_table[i].magic, magic_table[i].len) == 0) {
+            snprintf(type, type_size, "%s", magic_table[i].type);
+            // Script vẫn là văn bản
+            return strcmp(magic_table[i].type, "script") == 0;
+        }
+    }
+    
+    // Văn bản: không có NUL, ít ký tự điều khiển, byte >= 0x80 phải là UTF-8 hợp lệ
+    size_t control = 0;
+    int high = 0, utf8 = 1;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = buf[i];
+        if (c == 0) {
+            snprintf(type, type_size, "data");
+            return 0;
+        }
+        if (c < 0x20 && c != '\n' && c != '\r' && c != '\t' && c != '\f' && c != '\b' && c != 0x1b)
+            control++;
+        if (c < 0x80)
+            continue;
+        high = 1;
+        int extra = (c & 0xe0) == 0xc0 ? 1 : (c & 0xf0) == 0xe0 ? 2 : (c & 0xf8) == 0xf0 ? 3 : -1;
+        if (extra < 0) {
+            utf8 = 0;
+            continue;
+        }
+        for (int k = 1; k <= extra && i + k < len; k++) {
+            if ((buf[i + k] & 0xc0) != 0x80) {
+                utf8 = 0;
+                break;
+            }
+        }
+        i += extra;
+    }
+    if (control * 32 > len) {
+        snprintf(type, type_size, "data");
+        return 0;
+    }
+    snprintf(type, type_size, "%s", !high ? "ASCII text" : utf8 ? "UTF-8 text" : "8-bit text");
+    return 1;
+}
+
+int preview_cancelled(unsigned gen) {
+    return preview.gen != gen;
+}
+
+// Đọc đầu file trong giới hạn PREVIEW_BYTES / PREVIEW_BUDGET_MS; -1 nếu bị huỷ
+int preview_file(const char *path, Preview *pv, unsigned gen, long long deadline) {
+    unsigned char *buf = malloc(PREVIEW_BYTES);
+    size_t len = 0;
+    
+    if (buf == NULL)
+        return -1;
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        snprintf(pv->type, sizeof(pv->type), "unreadable (%s)", strerror(errno));
+        free(buf);
+        return 0;
+    }
+    while (len < PREVIEW_BYTES) {
+        ssize_t n = read(fd, buf + len, PREVIEW_BYTES - len < 16384 ? PREVIEW_BYTES - len : 16384);
+        if (n <= 0)
+            break;
+        len += n;
+        if (preview_cancelled(gen) || now_ms() > deadline)
+            break;
+    }
+    close(fd);
+    if (preview_cancelled(gen)) {
+        free(buf);
+        return -1;
+    }
+    
+    if (sniff_type(buf, len, pv->type, sizeof(pv->type))) {
+        pv->text = buf;
+        pv->text_len = len;
+    } else {
+        free(buf);
+    }
+    return 0;
+}
+
+// Đếm entry con và cộng kích thước file con trong giới hạn thời gian; -1 nếu bị huỷ
+int preview_dir(const char *path, Preview *pv, unsigned gen, long long deadline) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        snprintf(pv->type, sizeof(pv->type), "directory, unreadable (%s)", strerror(errno));
+        return 0;
+    }
+    snprintf(pv->type, sizeof(pv->type), "directory");
+    
+    struct dirent *entry;
+    struct stat st;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        pv->children++;
+        if (entry->d_type != DT_DIR &&
+            fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(st.st_mode))
+            pv->size += st.st_size;
+        if ((pv->children & 63) == 0) {
+            if (preview_cancelled(gen)) {
+                closedir(dir);
+                return -1;
+            }
+            if (now_ms() > deadline) {
+                pv->partial = 1;
+                break;
+            }
+        }
+    }
+    closedir(dir);
+    return preview_cancelled(gen) ? -1 : 0;
+}
+
+// Công bố kết quả cho request gen (phải giữ preview.lock)
+void preview_publish(unsigned gen, int slot, const char *error) {
+    preview.shown = slot;
+    preview.shown_gen = gen;
+    snprintf(preview.error, sizeof(preview.error), "%s", error);
+    wake_main_loop();
+}
+
+void preview_build(const char *path, unsigned gen) {
+    struct stat st;
+    
+    if (stat(path, &st) != 0) {
+        pthread_mutex_lock(&preview.lock);
+        if (!preview_cancelled(gen))
+            preview_publish(gen, -1, strerror(errno));
+        pthread_mutex_unlock(&preview.lock);
+        return;
+    }
+    
+    // Trúng cache: không cần đọc lại
+    pthread_mutex_lock(&preview.lock);
+    for (int i = 0; i < preview.cache_count; i++) {
+        Preview *c = &preview.cache[i];
+        if (c->dev == st.st_dev && c->ino == st.st_ino && c->mtime == st.st_mtime) {
+            c->used = ++preview.tick;
+            if (!preview_cancelled(gen))
+                preview_publish(gen, i, "");
+            pthread_mutex_unlock(&preview.lock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&preview.lock);
+    
+    Preview pv;
+    memset(&pv, 0, sizeof(pv));
+    pv.dev = st.st_dev;
+    pv.ino = st.st_ino;
+    pv.mtime = st.st_mtime;
+    pv.is_dir = S_ISDIR(st.st_mode);
+    pv.size = st.st_size;
+    
+    long long deadline = now_ms() + PREVIEW_BUDGET_MS;
+    int r = 0;
+    if (pv.is_dir) {
+        pv.size = 0;
+        r = preview_dir(path, &pv, gen, deadline);
+    } else if (S_ISREG(st.st_mode)) {
+        r = preview_file(path, &pv, gen, deadline);
+    } else {
+        // Không mở FIFO/thiết bị: open() hoặc read() có thể chặn
+        snprintf(pv.type, sizeof(pv.type), "%s",
+                 S_ISFIFO(st.st_mode) ? "fifo" : S_ISSOCK(st.st_mode) ? "socket" :
+                 S_ISCHR(st.st_mode) ? "character device" : S_ISBLK(st.st_mode) ? "block device" : "special file");
+    }
+    if (r < 0)
+        return;
+    
+    // Thay entry dùng lâu nhất
+    pthread_mutex_lock(&preview.lock);
+    int slot = preview.cache_count;
+    if (slot == PREVIEW_CACHE_MAX) {
+        slot = 0;
+        for (int i = 1; i < PREVIEW_CACHE_MAX; i++) {
+            if (preview.cache[i].used < preview.cache[slot].used)
+                slot = i;
         }
+        free(preview.cache[slot].text);
+    } else {
+        preview.cache_count++;
     }
-    
-    // Dọn dẹp
-    curs_set(0);  // Ẩn con trỏ
-    delwin(input_win);
-    delwin(ok_button);
-    delwin(cancel_button);
-    delwin(dialog);
-    touchwin(stdscr);
-    refresh();
-    
-    // Vẽ lại panel
-    display_panel(p);
+    pv.used = ++preview.tick;
+    preview.cache[slot] = pv;
+    if (!preview_cancelled(gen))
+        preview_publish(gen, slot, "");
+    pthread_mutex_unlock(&preview.lock);
 }
-void handle_delete(FilePanel *p) {
-    if (p->selected_idx < 0 || p->selected_idx >= p->file_count)
-        return;
+
+void *preview_worker(void *arg) {
+    (void)arg;
+    unsigned gen = 0;
+    char path[MAX_PATH];
+    
+    for (;;) {
+        pthread_mutex_lock(&preview.lock);
+        while (!preview.stop && preview.gen == gen)
+            pthread_cond_wait(&preview.cond, &preview.lock);
+        if (preview.stop) {
+            pthread_mutex_unlock(&preview.lock);
+            break;
+        }
+        gen = preview.gen;
+        snprintf(path, sizeof(path), "%s", preview.path);
+        pthread_mutex_unlock(&preview.lock);
         
-    // Bỏ qua trường hợp ".."
-    if (strcmp(p->files[p->selected_idx].name, "..") == 0)
-        return;
+        // Chờ con trỏ đứng yên: khi giữ phím mũi tên, request bị thay trước khi kịp đọc gì
+        usleep(PREVIEW_SETTLE_MS * 1000);
+        if (preview_cancelled(gen))
+            continue;
         
-    FileItem *selected_file = &p->files[p->selected_idx];
-    int is_dir = selected_file->is_dir;
+        preview_build(path, gen);
+    }
+    return NULL;
+}
+
+// Đặt request cho path; request cũ (nếu khác) bị huỷ. Không bao giờ chặn.
+void preview_request(const char *path, time_t mtime) {
+    pthread_mutex_lock(&preview.lock);
+    if (!preview.running) {
+        preview.running = pthread_create(&preview.thread, NULL, preview_worker, NULL) == 0;
+        preview.shown_gen = 0;
+        preview.gen = 0;
+    }
+    if (preview.gen == 0 || strcmp(preview.path, path) != 0 || preview.mtime != mtime) {
+        snprintf(preview.path, sizeof(preview.path), "%s", path);
+        preview.mtime = mtime;
+        preview.gen++;
+        pthread_cond_signal(&preview.cond);
+    }
+    pthread_mutex_unlock(&preview.lock);
+}
+
+void preview_shutdown() {
+    pthread_mutex_lock(&preview.lock);
+    int running = preview.running;
+    preview.stop = 1;
+    pthread_cond_signal(&preview.cond);
+    pthread_mutex_unlock(&preview.lock);
+    if (running)
+        pthread_join(preview.thread, NULL);
+    for (int i = 0; i < preview.cache_count; i++)
+        free(preview.cache[i].text);
+    preview.cache_count = 0;
+    preview.running = 0;
+}
+
+// Vẽ các dòng đầu của văn bản, thay ký tự không in được bằng '.'
+void draw_preview_text(WINDOW *win, const Preview *pv, int row, int last_row, int width) {
+    size_t pos = 0;
+    char line[MAX_PATH];
+    int max_cols = width - 4 < (int)sizeof(line) - 1 ? width - 4 : (int)sizeof(line) - 1;
     
-    // Lấy kích thước màn hình
-    int max_y, max_x;
-    getmaxyx(stdscr, max_y, max_x);
+    while (row <= last_row && pos < pv->text_len) {
+        int col = 0;
+        while (pos < pv->text_len && pv->text[pos] != '\n') {
+            unsigned char c = pv->text[pos++];
+            if (col >= max_cols)
+                continue;
+            if (c == '\t') {
+                do
+                    line[col++] = ' ';
+                while (col % 8 != 0 && col < max_cols);
+            } else if (c != '\r') {
+                line[col++] = (c >= 0x20 && c < 0x7f) ? c : '.';
+            }
+        }
+        pos++;
+        line[col] = '\0';
+        mvwprintw(win, row++, 2, "%s", line);
+    }
+}
+
+// Vẽ panel p dưới dạng quick view của entry đang chọn trong panel src
+void display_quick_view(FilePanel *p, FilePanel *src) {
+    int height, width;
+    char name[256] = "";
+    char path[MAX_PATH] = "";
+    char date_str[20] = "";
+    FileItem item;
+    int in_archive;
     
-    // Kích thước và vị trí hộp thoại
-    int dialog_height = 6;
-    int dialog_width = 40;
-    int dialog_y = (max_y - dialog_height) / 2;
-    int dialog_x = (max_x - dialog_width) / 2;
+    pthread_mutex_lock(&src->lock);
+    memset(&item, 0, sizeof(item));
+    if (src->selected_idx < src->file_count) {
+        item = src->files[src->selected_idx];
+        snprintf(name, sizeof(name), "%s", item.name);
+    }
+    in_archive = src->archive != NULL;
+    if (src->current_path[strlen(src->current_path) - 1] == '/')
+        snprintf(path, sizeof(path), "%s%s", src->current_path, name);
+    else
+        snprintf(path, sizeof(path), "%s/%s", src->current_path, name);
+    pthread_mutex_unlock(&src->lock);
     
-    // Tạo hộp thoại màu đỏ
-    WINDOW *dialog = newwin(dialog_height, dialog_width, dialog_y, dialog_x);
-    wbkgd(dialog, COLOR_PAIR(7));  // Màu nền đỏ
-    box(dialog, 0, 0);
+    werase(p->win);
+    wbkgd(p->win, COLOR_PAIR(1));
+    box(p->win, 0, 0);
+    getmaxyx(p->win, height, width);
+    mvwprintw(p->win, 0, 2, " Quick view ");
     
-    // Tiêu đề hộp thoại
-    mvwprintw(dialog, 0, (dialog_width - 6) / 2, " Delete ");
+    if (name[0] == '\0') {
+        wnoutrefresh(p->win);
+        return;
+    }
     
-    // Thông báo xác nhận xóa
-    char message[256];
-    if (is_dir) {
-        snprintf(message, sizeof(message), "Delete directory \"%s\"?", selected_file->name);
+    if (item.is_dir)
+        wattron(p->win, COLOR_PAIR(5));
+    mvwprintw(p->win, 1, 2, "%.*s", width - 4, name);
+    if (item.is_dir)
+        wattroff(p->win, COLOR_PAIR(5));
+    
+    // Member trong archive: chỉ có thông tin từ index, không đọc nội dung
+    if (in_archive) {
+        mvwprintw(p->win, 2, 2, "Type: %s", item.is_dir ? "directory in archive" :
+                  item.kind == ENTRY_SYMLINK ? "symlink in archive" :
+                  item.kind == ENTRY_HARDLINK ? "hard link in archive" :
+                  item.kind == ENTRY_SPECIAL ? "special file in archive" : "archive member");
+        if (!item.is_dir)
+            mvwprintw(p->win, 3, 2, "Size: %lld bytes", (long long)item.size);
+        if (item.mtime) {
+            strftime(date_str, sizeof(date_str), "%b %d %Y %H:%M", localtime(&item.mtime));
+            mvwprintw(p->win, 4, 2, "Modified: %s", date_str);
+        }
+        mvwprintw(p->win, height - 1, 2, "%.*s", width - 4, path);
+        wnoutrefresh(p->win);
+        return;
+    }
+    
+    preview_request(path, item.has_stat ? item.mtime : 0);
+    
+    pthread_mutex_lock(&preview.lock);
+    if (preview.shown_gen != preview.gen) {
+        mvwprintw(p->win, 2, 2, "...");
+    } else if (preview.shown < 0) {
+        mvwprintw(p->win, 2, 2, "Error: %.*s", width - 11, preview.error);
     } else {
-        snprintf(message, sizeof(message), "Delete file \"%s\"?", selected_file->name);
+        Preview *pv = &preview.cache[preview.shown];
+        mvwprintw(p->win, 2, 2, "Type: %.*s", width - 10, pv->type);
+        if (pv->is_dir)
+            mvwprintw(p->win, 3, 2, "Entries: %s%ld, files: %s%lld bytes", pv->partial ? ">" : "",
+                      pv->children, pv->partial ? ">" : "", (long long)pv->size);
+        else
+            mvwprintw(p->win, 3, 2, "Size: %lld bytes", (long long)pv->size);
+        strftime(date_str, sizeof(date_str), "%b %d %Y %H:%M", localtime(&pv->mtime));
+        mvwprintw(p->win, 4, 2, "Modified: %s", date_str);
+        if (pv->text != NULL) {
+            mvwhline(p->win, 5, 1, ACS_HLINE, width - 2);
+            draw_preview_text(p->win, pv, 6, height - 2, width);
+        }
     }
-    mvwprintw(dialog, 2, (dialog_width - strlen(message)) / 2, "%s", message);
+    pthread_mutex_unlock(&preview.lock);
     
-    // Tạo nút Yes
-    WINDOW *yes_button = newwin(1, 7, dialog_y + 4, dialog_x + 10);
-    wbkgd(yes_button, COLOR_PAIR(7));  // Màu nền đỏ
+    mvwprintw(p->win, height - 1, 2, "%.*s", width - 4, path);
+    wnoutrefresh(p->win);
+}
+
+// ---- Phiên làm việc và snapshot listing ----
+// Khi thoát: lưu đường dẫn, entry đang chọn và vị trí con trỏ của hai panel vào file session
+// (văn bản). Nếu FM_SNAPSHOT=1, listing của hai panel còn được ghi vào một snapshot nhị phân
+// có thể mmap trực tiếp: khi khởi động, FileItem.name trỏ thẳng vào vùng map nên listing
+// hiện ra ngay, rồi luồng nền so mtime của thư mục để quyết định có đọc lại hay không.
+
+typedef struct {
+    char magic[8];
+    uint32_t listing_count;
+    uint32_t reserved;
+    uint64_t file_size;
+} SnapshotHeader;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t path_off;        // Offset của đường dẫn (kết thúc bằng NUL) tính từ đầu file
+    uint64_t entries_off;     // Offset của mảng SnapshotEntry, căn 8 byte
+    uint32_t entry_count;
+    uint32_t reserved;
+} SnapshotListing;
+
+typedef struct {
+    uint64_t name_off;        // Offset của tên tính từ đầu file
+    int64_t size;
+    int64_t mtime;
+    uint32_t flags;           // SNAPSHOT_DIR | SNAPSHOT_STAT
+    uint32_t reserved;
+} SnapshotEntry;
+
+// Việc của luồng kiểm tra lại listing lấy từ snapshot
+typedef struct {
+    FilePanel *p;
+    char path[MAX_PATH];
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+} Revalidation;
+
+unsigned char *snapshot_map = NULL;
+size_t snapshot_size = 0;
+
+// Đường dẫn file trạng thái: $xdg/file_manager/name hoặc ~/fallback/file_manager/name
+int state_path(char *buf, size_t size, const char *xdg, const char *fallback, const char *name, int create) {
+    char dir[MAX_PATH];
+    const char *base = getenv(xdg);
+    const char *home = getenv("HOME");
     
-    // Tạo nút No
-    WINDOW *no_button = newwin(1, 6, dialog_y + 4, dialog_x + 24);
-    wbkgd(no_button, COLOR_PAIR(7));  // Màu nền đỏ
+    if (base != NULL && base[0] == '/')
+        snprintf(dir, sizeof(dir), "%s/file_manager", base);
+    else if (home != NULL && home[0] == '/')
+        snprintf(dir, sizeof(dir), "%s/%s/file_manager", home, fallback);
+    else
+        return -1;
+    if (create && make_dirs(dir) != 0)
+        return -1;
+    snprintf(buf, size, "%s/%s", dir, name);
+    return 0;
+}
+
+int snapshot_enabled() {
+    const char *env = getenv("FM_SNAPSHOT");
+    return env != NULL && strcmp(env, "1") == 0;
+}
+
+void session_load(Session *s) {
+    char path[MAX_PATH];
+    char line[MAX_PATH + 32];
     
-    // Trạng thái focus: 0 = Yes, 1 = No
-    int focus_state = 1;  // Mặc định focus vào No (an toàn hơn)
+    memset(s, 0, sizeof(*s));
+    if (state_path(path, sizeof(path), "XDG_CONFIG_HOME", ".config", "session", 0) != 0)
+        return;
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return;
     
-    // Hiển thị nút với focus ban đầu
-    wattron(yes_button, A_REVERSE);
-    wattron(no_button, A_REVERSE);
+    // Mỗi dòng "khoá giá trị"; giá trị là phần còn lại của dòng (có thể chứa dấu cách)
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        char *value = strchr(line, ' ');
+        if (line[0] == '#' || value == NULL)
+            continue;
+        *value++ = '\0';
+        
+        int side = strncmp(line, "left.", 5) == 0 ? 0 : strncmp(line, "right.", 6) == 0 ? 1 : -1;
+        const char *key = side < 0 ? line : strchr(line, '.') + 1;
+        if (side < 0 && strcmp(key, "active") == 0)
+            s->active = strcmp(value, "right") == 0;
+        else if (side < 0 && strcmp(key, "quick_view") == 0)
+            s->quick_view = atoi(value) != 0;
+        else if (side >= 0 && strcmp(key, "path") == 0 && value[0] == '/')
+            snprintf(s->path[side], sizeof(s->path[side]), "%s", value);
+        else if (side >= 0 && strcmp(key, "selected") == 0)
+            snprintf(s->selected[side], sizeof(s->selected[side]), "%s", value);
+        else if (side >= 0 && strcmp(key, "row") == 0)
+            s->row[side] = atoi(value);
+    }
+    fclose(f);
+}
+
+// Đường dẫn tuyệt đối để lưu cho panel; bên trong archive thì lưu thư mục chứa archive
+// và chọn sẵn file archive
+void session_panel(FilePanel *p, char *path, char *selected, int *row) {
+    char dir[MAX_PATH];
     
-    if (focus_state == 0) {
-        wattroff(no_button, A_REVERSE);
+    path[0] = '\0';
+    selected[0] = '\0';
+    *row = 0;
+    if (p->archive != NULL) {
+        snprintf(dir, sizeof(dir), "%s", p->archive->path);
+        char *slash = strrchr(dir, '/');
+        if (slash != NULL) {
+            snprintf(selected, 256, "%s", slash + 1);
+            if (slash == dir)
+                slash[1] = '\0';
+            else
+                *slash = '\0';
+        } else {
+            snprintf(selected, 256, "%s", dir);
+            strcpy(dir, ".");
+        }
     } else {
-        wattroff(yes_button, A_REVERSE);
+        snprintf(dir, sizeof(dir), "%s", p->current_path);
+        if (p->selected_idx < p->file_count) {
+            snprintf(selected, 256, "%s", p->files[p->selected_idx].name);
+            *row = p->selected_idx - p->start_idx;
+        }
     }
+    if (realpath(dir, path) == NULL)
+        path[0] = '\0';
+    if (strchr(selected, '\n') != NULL)
+        selected[0] = '\0';
+}
+
+void session_save(FilePanel *left, FilePanel *right, FilePanel *active) {
+    char path[MAX_PATH], tmp[MAX_PATH + 8];
+    char dir[MAX_PATH], selected[256];
+    int row;
     
-    // Vẽ nội dung nút
-    mvwprintw(yes_button, 0, 1, " Yes ");
-    mvwprintw(no_button, 0, 1, " No ");
+    if (state_path(path, sizeof(path), "XDG_CONFIG_HOME", ".config", "session", 1) != 0)
+        return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL)
+        return;
     
-    // Hiển thị hộp thoại và các nút
-    wrefresh(dialog);
-    wrefresh(yes_button);
-    wrefresh(no_button);
+    fprintf(f, "# file_manager session\n");
+    fprintf(f, "active %s\n", active == right ? "right" : "left");
+    fprintf(f, "quick_view %d\n", quick_view);
+    for (int side = 0; side < 2; side++) {
+        const char *prefix = side == 0 ? "left" : "right";
+        session_panel(side == 0 ? left : right, dir, selected, &row);
+        if (dir[0] == '\0' || strchr(dir, '\n') != NULL)
+            continue;
+        fprintf(f, "%s.path %s\n", prefix, dir);
+        if (selected[0] != '\0')
+            fprintf(f, "%s.selected %s\n", prefix, selected);
+        fprintf(f, "%s.row %d\n", prefix, row);
+    }
     
-    // Xử lý phím
-    keypad(dialog, TRUE);
-    int ch;
+    if (fclose(f) == 0)
+        rename(tmp, path);
+    else
+        unlink(tmp);
+}
+
+// Đặt con trỏ như lúc thoát (nếu entry vẫn còn trong listing)
+void session_select(FilePanel *p, const Session *s, int side) {
+    if (s->selected[side][0] == '\0')
+        return;
+    pthread_mutex_lock(&p->lock);
+    select_file(p, s->selected[side]);
+    if (p->selected_idx > 0) {
+        p->start_idx = p->selected_idx - s->row[side];
+        if (p->start_idx < 0)
+            p->start_idx = 0;
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+// Map snapshot vào bộ nhớ; chỉ kiểm tra phần đầu, từng listing được kiểm tra khi dùng
+void snapshot_open() {
+    char path[MAX_PATH];
+    struct stat st;
     
-    while (1) {
-        ch = wgetch(dialog);
-        
-        if (ch == KEY_LEFT || ch == KEY_RIGHT) {
-            // Chuyển đổi focus giữa hai nút
-            focus_state = !focus_state;
-            
-            // Cập nhật hiển thị nút
-            if (focus_state == 0) {
-                wattron(yes_button, A_REVERSE);
-                wattroff(no_button, A_REVERSE);
+    if (!snapshot_enabled() ||
+        state_path(path, sizeof(path), "XDG_CACHE_HOME", ".cache", "snapshot", 0) != 0)
+        return;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    if (fstat(fd, &st) == 0 && st.st_size > (off_t)sizeof(SnapshotHeader)) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            const SnapshotHeader *h = map;
+            // Byte cuối là NUL nên mọi tên trong file đều kết thúc bên trong vùng map
+            if (memcmp(h->magic, SNAPSHOT_MAGIC, 8) == 0 && h->file_size == (uint64_t)st.st_size &&
+                h->listing_count <= (st.st_size - sizeof(SnapshotHeader)) / sizeof(SnapshotListing) &&
+                ((unsigned char *)map)[st.st_size - 1] == '\0') {
+                snapshot_map = map;
+                snapshot_size = st.st_size;
             } else {
-                wattroff(yes_button, A_REVERSE);
-                wattron(no_button, A_REVERSE);
-            }
-            
-            // Vẽ lại nội dung nút
-            mvwprintw(yes_button, 0, 1, " Yes ");
-            mvwprintw(no_button, 0, 1, " No ");
-            
-            wrefresh(yes_button);
-            wrefresh(no_button);
-        } else if (ch == '\n') {
-            // Enter = xác nhận lựa chọn hiện tại
-            if (focus_state == 0) {  // Chọn Yes
-                // Xóa thư mục hoặc file
-                char path[MAX_PATH];
-                snprintf(path, MAX_PATH, "%s/%s", p->current_path, selected_file->name);
-                
-                int delete_success = 0;
-                if (is_dir) {
-                    delete_success = rmdir(path) == 0;
-                } else {
-                    delete_success = unlink(path) == 0;
-                }
-                
-                if (!delete_success) {
-                    // Hiển thị thông báo lỗi
-                    if (is_dir) {
-                        mvwprintw(dialog, 4, 5, "Error: Directory not empty!");
-                    } else {
-                        mvwprintw(dialog, 4, 8, "Error: Cannot delete file!");
-                    }
-                    wrefresh(dialog);
-                    napms(1500);
-                } else {
-                    // Cập nhật lại danh sách file
-                    read_directory(p);
-                }
-                break;
-            } else {  // Chọn No
-                break;
+                munmap(map, st.st_size);
             }
-        } else if (ch == 27) {  // ESC = Cancel
+        }
+    }
+    close(fd);
+}
+
+void snapshot_close() {
+    if (snapshot_map != NULL)
+        munmap(snapshot_map, snapshot_size);
+    snapshot_map = NULL;
+    snapshot_size = 0;
+}
+
+void *snapshot_revalidate(void *arg) {
+    Revalidation *job = arg;
+    FilePanel *p = job->p;
+    struct stat st;
+    
+    // Có thể chặn lâu (NFS), nên làm ở đây thay vì trong luồng chính
+    DIR *dir = opendir(job->path);
+    int fresh = dir != NULL && fstat(dirfd(dir), &st) == 0 &&
+                st.st_dev == job->dev && st.st_ino == job->ino &&
+                st.st_mtim.tv_sec == job->mtime.tv_sec && st.st_mtim.tv_nsec == job->mtime.tv_nsec;
+    
+    pthread_mutex_lock(&p->lock);
+    if (p->snapshot_state == SNAPSHOT_CHECKING) {
+        p->snapshot_state = fresh ? SNAPSHOT_FRESH : SNAPSHOT_STALE;
+        if (fresh) {
+            p->snapshot_dir = dir;
+            dir = NULL;
+        }
+    }
+    p->revalidating = 0;
+    pthread_mutex_unlock(&p->lock);
+    
+    if (dir != NULL)
+        closedir(dir);
+    free(job);
+    wake_main_loop();
+    return NULL;
+}
+
+// Dựng listing của panel từ snapshot (nếu có) và bắt đầu kiểm tra lại ở nền
+int snapshot_restore(FilePanel *p) {
+    const SnapshotHeader *h = (const SnapshotHeader *)snapshot_map;
+    const SnapshotListing *listings;
+    const SnapshotListing *l = NULL;
+    
+    if (snapshot_map == NULL)
+        return 0;
+    listings = (const SnapshotListing *)(snapshot_map + sizeof(SnapshotHeader));
+    for (uint32_t i = 0; i < h->listing_count; i++) {
+        if (listings[i].path_off < snapshot_size &&
+            strcmp((const char *)snapshot_map + listings[i].path_off, p->current_path) == 0) {
+            l = &listings[i];
             break;
         }
     }
+    if (l == NULL || l->entry_count == 0 || l->entries_off % 8 != 0 || l->entries_off > snapshot_size ||
+        (snapshot_size - l->entries_off) / sizeof(SnapshotEntry) < l->entry_count)
+        return 0;
     
-    // Dọn dẹp
-    delwin(yes_button);
-    delwin(no_button);
-    delwin(dialog);
-    touchwin(stdscr);
-    refresh();
+    FileItem *files = malloc(l->entry_count * sizeof(FileItem));
+    if (files == NULL)
+        return 0;
+    const SnapshotEntry *entries = (const SnapshotEntry *)(snapshot_map + l->entries_off);
+    for (uint32_t i = 0; i < l->entry_count; i++) {
+        if (entries[i].name_off >= snapshot_size) {
+            free(files);
+            return 0;
+        }
+        files[i].name = (char *)snapshot_map + entries[i].name_off;
+        files[i].is_dir = (entries[i].flags & SNAPSHOT_DIR) != 0;
+        files[i].has_stat = (entries[i].flags & SNAPSHOT_STAT) != 0;
+        files[i].size = entries[i].size;
+        files[i].mtime = entries[i].mtime;
+        files[i].kind = ENTRY_FILE;
+    }
     
-    // Vẽ lại panel
-    display_panel(p);
+    Revalidation *job = malloc(sizeof(Revalidation));
+    if (job == NULL) {
+        free(files);
+        return 0;
+    }
+    
+    // Tên nằm trong vùng map, không thuộc NameBlock nào của panel
+    clear_files(p);
+    free(p->files);
+    p->files = files;
+    p->file_count = l->entry_count;
+    p->file_capacity = l->entry_count;
+    p->listed_dev = l->dev;
+    p->listed_ino = l->ino;
+    p->listed_mtime.tv_sec = l->mtime_sec;
+    p->listed_mtime.tv_nsec = l->mtime_nsec;
+    
+    job->p = p;
+    snprintf(job->path, sizeof(job->path), "%s", p->current_path);
+    job->dev = p->listed_dev;
+    job->ino = p->listed_ino;
+    job->mtime = p->listed_mtime;
+    p->snapshot_state = SNAPSHOT_CHECKING;
+    p->revalidating = 1;
+    if (pthread_create(&p->revalidator, NULL, snapshot_revalidate, job) == 0) {
+        p->revalidator_started = 1;
+    } else {
+        // Không kiểm tra được thì coi như đã cũ
+        p->snapshot_state = SNAPSHOT_STALE;
+        p->revalidating = 0;
+        free(job);
+    }
+    return 1;
+}
+
+// Gọi mỗi khung hình: nhận kết quả kiểm tra lại; trả về 1 nếu panel cần vẽ lại
+int snapshot_check(FilePanel *p) {
+    pthread_mutex_lock(&p->lock);
+    int state = p->snapshot_state;
+    DIR *dir = p->snapshot_dir;
+    if (state == SNAPSHOT_FRESH || state == SNAPSHOT_STALE) {
+        p->snapshot_state = SNAPSHOT_NONE;
+        p->snapshot_dir = NULL;
+    }
+    pthread_mutex_unlock(&p->lock);
+    
+    if (state == SNAPSHOT_STALE) {
+        p->reload_pending |= RELOAD_CHANGED;
+        return 1;
+    }
+    if (state != SNAPSHOT_FRESH)
+        return 0;
+    
+    watch_directory(p);
+    
+    // Còn entry chưa stat (listing ảo lúc lưu): giao thư mục cho worker như listing ảo đã liệt kê xong
+    int i = 0;
+    while (i < p->file_count && p->files[i].has_stat)
+        i++;
+    if (i < p->file_count) {
+        p->vdir = dir;
+        p->virtual_mode = 1;
+        p->enumerating = 0;
+        p->est_count = p->file_count;
+        start_worker(p);
+    } else {
+        closedir(dir);
+    }
+    return 1;
 }
 
+// Bỏ kết quả kiểm tra đang chờ khi panel rời listing lấy từ snapshot
+void snapshot_discard(FilePanel *p) {
+    pthread_mutex_lock(&p->lock);
+    DIR *dir = p->snapshot_dir;
+    p->snapshot_state = SNAPSHOT_NONE;
+    p->snapshot_dir = NULL;
+    pthread_mutex_unlock(&p->lock);
+    if (dir != NULL)
+        closedir(dir);
+}
+
+void snapshot_shutdown(FilePanel *p) {
+    snapshot_discard(p);
+    pthread_mutex_lock(&p->lock);
+    int pending = p->revalidating;
+    pthread_mutex_unlock(&p->lock);
+    if (p->revalidator_started) {
+        // Luồng còn kẹt trong opendir (NFS) thì không chờ
+        if (pending)
+            pthread_detach(p->revalidator);
+        else
+            pthread_join(p->revalidator, NULL);
+        p->revalidator_started = 0;
+    }
+}
+
+int snapshot_usable(FilePanel *p) {
+    return p->archive == NULL && !p->enumerating && p->file_count > 0 && p->listed_ino != 0;
+}
+
+// Ghi listing của các panel vào snapshot mới rồi rename đè lên file cũ (file cũ có thể
+// đang được map và tên của panel vẫn trỏ vào đó)
+void snapshot_save(FilePanel **panels, int count) {
+    char path[MAX_PATH], tmp[MAX_PATH + 8];
+    SnapshotHeader h;
+    SnapshotListing listings[2];
+    FilePanel *used[2];
+    char keys[2][MAX_PATH];   // Đường dẫn tuyệt đối, khớp với đường dẫn session khôi phục
+    int n = 0;
+    static const char zeros[8];
+    
+    if (!snapshot_enabled())
+        return;
+    for (int i = 0; i < count && n < 2; i++) {
+        if (snapshot_usable(panels[i]) && realpath(panels[i]->current_path, keys[n]) != NULL &&
+            (n == 0 || strcmp(keys[0], keys[n]) != 0))
+            used[n++] = panels[i];
+    }
+    if (n == 0 || state_path(path, sizeof(path), "XDG_CACHE_HOME", ".cache", "snapshot", 1) != 0)
+        return;
+    
+    // Lượt 1: tính offset; mỗi listing gồm đường dẫn, mảng entry rồi vùng tên
+    uint64_t offset = sizeof(SnapshotHeader) + n * sizeof(SnapshotListing);
+    for (int i = 0; i < n; i++) {
+        FilePanel *p = used[i];
+        SnapshotListing *l = &listings[i];
+        memset(l, 0, sizeof(*l));
+        l->dev = p->listed_dev;
+        l->ino = p->listed_ino;
+        l->mtime_sec = p->listed_mtime.tv_sec;
+        l->mtime_nsec = p->listed_mtime.tv_nsec;
+        l->path_off = offset;
+        offset += (strlen(keys[i]) + 1 + 7) & ~7ULL;
+        l->entries_off = offset;
+        l->entry_count = p->file_count;
+        offset += p->file_count * sizeof(SnapshotEntry);
+        for (int j = 0; j < p->file_count; j++)
+            offset += strlen(p->files[j].name) + 1;
+        offset = (offset + 7) & ~7ULL;
+    }
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, 8);
+    h.listing_count = n;
+    h.file_size = offset;
+    
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL)
+        return;
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(listings, sizeof(SnapshotListing), n, f);
+    
+    // Lượt 2: ghi dữ liệu đúng theo các offset đã tính
+    for (int i = 0; i < n; i++) {
+        FilePanel *p = used[i];
+        size_t len = strlen(keys[i]) + 1;
+        fwrite(keys[i], 1, len, f);
+        fwrite(zeros, 1, (listings[i].entries_off - listings[i].path_off) - len, f);
+        
+        uint64_t name_off = listings[i].entries_off + p->file_count * sizeof(SnapshotEntry);
+        for (int j = 0; j < p->file_count; j++) {
+            SnapshotEntry e;
+            memset(&e, 0, sizeof(e));
+            e.name_off = name_off;
+            e.size = p->files[j].size;
+            e.mtime = p->files[j].mtime;
+            e.flags = (p->files[j].is_dir ? SNAPSHOT_DIR : 0) | (p->files[j].has_stat ? SNAPSHOT_STAT : 0);
+            fwrite(&e, sizeof(e), 1, f);
+            name_off += strlen(p->files[j].name) + 1;
+        }
+        for (int j = 0; j < p->file_count; j++)
+            fwrite(p->files[j].name, 1, strlen(p->files[j].name) + 1, f);
+        uint64_t end = i + 1 < n ? listings[i + 1].path_off : h.file_size;
+        fwrite(zeros, 1, end - name_off, f);
+    }
+    
+    int failed = ferror(f);
+    if (fclose(f) != 0 || failed)
+        unlink(tmp);
+    else
+        rename(tmp, path);
+}
 
 void handle_key(int key, FilePanel *left, FilePanel *right, FilePanel **active) {
     FilePanel *p = *active;
@@ -640,6 +4475,12 @@ void handle_key(int key, FilePanel *left, FilePanel *right, FilePanel **active)
     getmaxyx(p->win, height, width);
     int display_count = height - 3; // Số file có thể hiển thị trong panel
     
+    // Giữ lock trong suốt thao tác trên danh sách, nhả ra trước các thao tác chặn
+    pthread_mutex_lock(&p->lock);
+    
+    // Người dùng đã tự di chuyển: không nhảy con trỏ về entry cũ nữa
+    p->select_pending[0] = '\0';
+    
     switch(key) {
         case KEY_UP:
             if (p->selected_idx > 0) {
@@ -692,6 +4533,19 @@ void handle_key(int key, FilePanel *left, FilePanel *right, FilePanel **active)
             break;
                 
         case '\n':  // Enter để vào thư mục
+            ensure_stat(p, p->selected_idx);
+            
+            // Bên trong archive, hoặc Enter trên file archive: mở như thư mục ảo
+            if (p->archive != NULL ||
+                (!p->files[p->selected_idx].is_dir && archive_type(p->files[p->selected_idx].name) >= 0)) {
+                char name[256];
+                int is_dir = p->files[p->selected_idx].is_dir;
+                snprintf(name, sizeof(name), "%s", p->files[p->selected_idx].name);
+                pthread_mutex_unlock(&p->lock);
+                enter_archive(p, name, is_dir);
+                return;
+            }
+            
             if (p->files[p->selected_idx].is_dir) {
                 if (strcmp(p->files[p->selected_idx].name, "..") == 0) {
                     // Xử lý đường dẫn "."
@@ -749,7 +4603,9 @@ void handle_key(int key, FilePanel *left, FilePanel *right, FilePanel **active)
                 // Đặt lại vị trí và đọc thư mục mới
                 p->selected_idx = 0;
                 p->start_idx = 0;
+                pthread_mutex_unlock(&p->lock);
                 read_directory(p);
+                return;
             }
             break;
 
@@ -763,7 +4619,8 @@ void handle_key(int key, FilePanel *left, FilePanel *right, FilePanel **active)
             break;
         
         case KEY_F(3):
-            // Xử lý F3: Xem tệp (chưa triển khai chi tiết)
+            // F3: bật/tắt quick view ở panel không hoạt động
+            quick_view = !quick_view;
             break;
         
         case KEY_F(4):
@@ -771,27 +4628,39 @@ void handle_key(int key, FilePanel *left, FilePanel *right, FilePanel **active)
             break;
         
         case KEY_F(5):
-            // Xử lý F5: Sao chép (chưa triển khai chi tiết)
-            break;
+            // Trong archive: F5 giải nén sang panel kia
+            if (p->archive != NULL) {
+                pthread_mutex_unlock(&p->lock);
+                handle_extract(p, p == left ? right : left);
+                return;
+            }
+            // Xử lý F5: Sao chép
+            pthread_mutex_unlock(&p->lock);
+            handle_copy(p, p == left ? right : left);
+            return;
         
         case KEY_F(6):
             // Xử lý F6: Di chuyển (chưa triển khai chi tiết)
             break;
         
         case KEY_F(7):
+            pthread_mutex_unlock(&p->lock);
             handle_mkdir(p);
             // Xử lý F7: Tạo thư mục (chưa triển khai chi tiết)
-            break;
+            return;
         
         case KEY_F(8):
+            pthread_mutex_unlock(&p->lock);
             handle_delete(p);
             // Xử lý F8: Xóa (chưa triển khai chi tiết)
-            break;
+            return;
         
         case KEY_F(9):
             // Xử lý F9: Thoát (đã được xử lý trong main)
             break;
     }
+    
+    pthread_mutex_unlock(&p->lock);
 }
 
 